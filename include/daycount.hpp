@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Day count conventions and discounting of the pay-off price to the current one.
+ * Each (convention, compounding) pair is a template instance with integer-only
+ * arithmetic; accrual_basis byte of a dbond selects the instance through price_table.
+ * The header does not depend on eosio so that off-chain tools can share the pricing.
+ */
+
+namespace daycount {
+
+  // accrual_basis byte: bits 0-1 convention, bit 2 compounding
+  enum convention: uint8_t {
+    ACT_365 = 0,
+    ACT_360 = 1,
+    THIRTY_360 = 2,
+    ACT_ACT = 3
+  };
+
+  enum compounding: uint8_t {
+    SIMPLE = 0,
+    COMPOUND = 4            // annual compounding, simple interest within a year
+  };
+
+  constexpr uint8_t basis_count = 8;
+  constexpr int64_t day_seconds = 24 * 60 * 60;
+  constexpr int64_t apr_scale = 10000;         // apr 1000 means 10%
+
+  // bounds of dbond terms, see check_fcdb_terms_sanity; compounding beyond them is priced
+  //   as at the bound, which keeps the accrual factor below 2^30
+  constexpr uint32_t max_apr = 10000;
+  constexpr int64_t max_years = 30;
+
+  // year fraction as num / den
+  struct fraction {
+    int64_t num;
+    int64_t den;
+  };
+
+  /*
+   * proleptic Gregorian calendar helpers (H. Hinnant's algorithms), days since 1970-01-01
+   */
+  struct civil_date {
+    int64_t y;
+    int64_t m;
+    int64_t d;
+  };
+
+  constexpr int64_t days_from_civil(int64_t y, int64_t m, int64_t d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+  }
+
+  constexpr civil_date civil_from_days(int64_t z) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int64_t d = doy - (153 * mp + 2) / 5 + 1;
+    int64_t m = mp + (mp < 10 ? 3 : -9);
+    return {yoe + era * 400 + (m <= 2), m, d};
+  }
+
+  constexpr bool is_leap(int64_t y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+  }
+
+  constexpr int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+  }
+
+  /*
+   * conventions, times are seconds since epoch, from <= to
+   */
+  struct act_365 {
+    static constexpr fraction year_fraction(int64_t from, int64_t to) {
+      return {to - from, 365 * day_seconds};
+    }
+  };
+
+  struct act_360 {
+    static constexpr fraction year_fraction(int64_t from, int64_t to) {
+      return {to - from, 360 * day_seconds};
+    }
+  };
+
+  // 30/360 US bond basis
+  struct thirty_360 {
+    static constexpr fraction year_fraction(int64_t from, int64_t to) {
+      civil_date a = civil_from_days(floor_div(from, day_seconds));
+      civil_date b = civil_from_days(floor_div(to, day_seconds));
+      int64_t d1 = a.d == 31 ? 30 : a.d;
+      int64_t d2 = (b.d == 31 && d1 == 30) ? 30 : b.d;
+      int64_t days = 360 * (b.y - a.y) + 30 * (b.m - a.m) + (d2 - d1);
+      int64_t intraday = (to - floor_div(to, day_seconds) * day_seconds) - (from - floor_div(from, day_seconds) * day_seconds);
+      return {days * day_seconds + intraday, 360 * day_seconds};
+    }
+  };
+
+  // ACT/ACT ISDA: time in leap years counts in 366ths, the rest in 365ths
+  struct act_act {
+    static constexpr fraction year_fraction(int64_t from, int64_t to) {
+      int64_t in_365 = 0;
+      int64_t in_366 = 0;
+      int64_t y = civil_from_days(floor_div(from, day_seconds)).y;
+      for(int64_t cur = from; cur < to; y++) {
+        int64_t year_end = days_from_civil(y + 1, 1, 1) * day_seconds;
+        int64_t next = to < year_end ? to : year_end;
+        (is_leap(y) ? in_366 : in_365) += next - cur;
+        cur = next;
+      }
+      return {in_365 * 366 + in_366 * 365, 365 * 366 * day_seconds};
+    }
+  };
+
+  /*
+   * present value of face paid at maturity, rounded up to the asset's smallest unit;
+   * zero at and after maturity. Compounding saturates at max_apr and max_years.
+   */
+  template<typename Convention, bool Compound>
+  int64_t discounted_price(int64_t face, uint32_t apr, int64_t now, int64_t maturity) {
+    if(now >= maturity)
+      return 0;
+    fraction yf = Convention::year_fraction(now, maturity);
+
+    if(Compound) {
+      int64_t years = yf.num / yf.den;
+      int64_t rest = yf.num % yf.den;
+      if(apr > max_apr)
+        apr = max_apr;
+      if(years >= max_years) {
+        years = max_years;
+        rest = 0;
+      }
+      // (1 + apr)^years in 1e12 fixed point, by squaring; base is not squared past the
+      //   highest bit of years, so no product exceeds 2^30 * 2^15 * one^2
+      const __int128 one = 1000000000000;
+      __int128 growth = one;
+      __int128 base = one * (apr_scale + apr) / apr_scale;
+      for(int64_t e = years; e > 0; e >>= 1) {
+        if(e & 1)
+          growth = growth * base / one;
+        if(e > 1)
+          base = base * base / one;
+      }
+      // simple interest within the last year; rounded down, so that the price is rounded up
+      __int128 factor = growth + growth * apr * rest / ((__int128)yf.den * apr_scale);
+      __int128 scaled = (__int128)face * one;
+      return int64_t((scaled + factor - 1) / factor);
+    }
+    __int128 factor_num = (__int128)yf.den * apr_scale + (__int128)apr * yf.num;
+    __int128 factor_den = (__int128)yf.den * apr_scale;
+    __int128 scaled = (__int128)face * factor_den;
+    return int64_t((scaled + factor_num - 1) / factor_num);
+  }
+
+  using price_fn = int64_t (*)(int64_t face, uint32_t apr, int64_t now, int64_t maturity);
+
+  // indexed by accrual_basis byte
+  constexpr price_fn price_table[basis_count] = {
+    &discounted_price<act_365, false>,
+    &discounted_price<act_360, false>,
+    &discounted_price<thirty_360, false>,
+    &discounted_price<act_act, false>,
+    &discounted_price<act_365, true>,
+    &discounted_price<act_360, true>,
+    &discounted_price<thirty_360, true>,
+    &discounted_price<act_act, true>
+  };
+
+  constexpr bool valid_basis(uint8_t basis) {
+    return basis < basis_count;
+  }
+
+  inline int64_t price(uint8_t basis, int64_t face, uint32_t apr, int64_t now, int64_t maturity) {
+    return price_table[basis % basis_count](face, apr, now, maturity);
+  }
+
+} // namespace daycount
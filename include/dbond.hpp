@@ -9,10 +9,10 @@ using namespace std;
 using namespace eosio;
 
 struct fiat_bond {
-  string ISIN;
+  uint64_t ISIN;                                            // 12 ISIN characters packed, see utility::isin_code()
   string name;
   string issuer;
-  string currency;
+  symbol_code currency;
   time_point maturity_time;
   string bond_description_webpage;
 };
@@ -34,15 +34,24 @@ struct dbond {
 };
 
 struct fc_dbond : dbond {
-  fiat_bond                        collateral_bond;         // 
+  uint64_t                         collateral_isin;         // ISIN of the collateral in fiatbonds registry
   name                             verifier;
   name                             counterparty;
   name                             liquidation_agent;       // the one responsible for handling the fiat assets in case of default
   string                           escrow_contract_link;
-  int64_t                          apr;                     // in format where 1000 meaning 10%
+  uint16_t                         apr;                     // in format where 1000 meaning 10%
+  uint8_t                          accrual_basis;           // day count convention and compounding, see daycount.hpp
   vector<name>                     holders_list;            // list of accounts, any other cannot obtain the dbond
 };
 
+// per-dbond terms of a series sharing all other fc_dbond fields
+struct fc_dbond_delta {
+  dbond_id_class                   dbond_id;
+  asset                            quantity_to_issue;
+  time_point                       maturity_time;
+  extended_asset                   payoff_price;
+};
+
 struct cc_dbond : dbond {
   extended_asset                   crypto_collateral;       // in case when collateral_type is CRYPTO_ASSET, this field stores asset
   int                              early_payoff_policy;     // if available, how is organized
@@ -1,18 +1,34 @@
 #pragma once
 
 #include "dbond.hpp"
+#include "profile.hpp"
+#include "daycount.hpp"
+#include "lifecycle.hpp"
 
 #include <eosio/eosio.hpp>
 #include <eosio/print.hpp>
+#include <eosio/singleton.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/transaction.hpp>
+
+#include <algorithm>
+#include <limits>
 
 const name DBVERIFIER("fcdbverifier");
 
+// Build flags selecting optional parts of the contract (see Makefile profiles):
+//   DEBUG               erase, setstate and unindex actions
+//   NO_PRIVATE_ORDERS   no listprivord action, "sell"/"buy" memos and fcdborders table
+//   NO_CC_DBONDS        no crypto-collateralized dbonds, vaults and claims
+//   NO_BASKETS          no basket tokens
+// fc dbonds are the base of the token and are always built.
+
 using namespace eosio;
 using namespace std;
 
 namespace utility {
 
-  enum class fcdb_state: int {
+  enum class fcdb_state: uint8_t {
     CREATED = 0,
     AGREEMENT_SIGNED = 1,
     CIRCULATING = 2,
@@ -22,43 +38,187 @@ namespace utility {
     First = CREATED,
     Last = EXPIRED_DEFAULTED
   };
+  static_assert(uint8_t(fcdb_state::Last) + 1 == lifecycle::state_count, "fcdb_state and lifecycle::state differ");
   
   bool is_final_state(utility::fcdb_state state){
     return state == fcdb_state::EXPIRED_PAID_OFF || state == fcdb_state::EXPIRED_DEFAULTED;
   }
+
+  // events an account may subscribe to be notified about, bit flags
+  enum event_type: uint8_t {
+    EVENT_TRANSFER = 1,
+    EVENT_ORDER = 2,
+    EVENT_STATE = 4,
+    EVENT_RETIRE = 8,
+    EVENT_ALL = EVENT_TRANSFER | EVENT_ORDER | EVENT_STATE | EVENT_RETIRE
+  };
+
+  // record types of the event log
+  enum log_type: uint8_t {
+    LOG_STATE = 0,            // amount: new fcdb_state
+    LOG_TRADE = 1,            // account: seller, counterparty: buyer, amount: dbond units, value: paid
+    LOG_RETIRE = 2            // account: holder or liquidation agent, amount: dbond units, value: paid out
+  };
+
+  uint32_t default_event_log_capacity = 1024;
 }
 
+// one recipient of the batch transfer action
+struct transfer_entry {
+  name    to;
+  asset   quantity;
+  string  memo;
+};
+
+// one point of dbond price history, see gethist action
+struct price_point {
+  time_point_sec  time;
+  int64_t         price;              // amount of dbond current_price
+};
+
+// balance of one holder of a dbond, see getholders and topholders actions
+struct holder_balance {
+  name            holder;
+  int64_t         amount;             // smallest dbond units
+};
+
+// dbond of a basket and its amount in one whole basket token
+struct basket_component {
+  asset           quantity;
+  name            emitent;            // scope of the dbond's fcdbond row
+};
+
+// event of an account subscribed in batched mode, see logevents action
+struct event_note {
+  name            account;
+  uint8_t         event;              // utility::event_type
+  dbond_id_class  dbond_id;
+};
+
 CONTRACT dbonds : public contract {
 public:
-  using contract::contract;
+  dbonds(name receiver, name code, datastream<const char*> ds)
+    : contract(receiver, code, ds), subscribers(receiver, receiver.value) {}
   
   // classic token actions
   ACTION transfer(name from, name to, asset quantity, const string& memo);
 
+  ACTION transfers(name from, const vector<transfer_entry>& transfers);
+
   ACTION create(name issuer, asset maximum_supply);
 
   ACTION issue(name to, asset quantity, string memo);
 
+  // open, close and gc return the number of RAM bytes used or reclaimed
+  [[eosio::action]] uint64_t open(name owner, const symbol& symbol, name ram_payer);
+
+  [[eosio::action]] uint64_t close(name owner, const symbol& symbol);
+
   // dbond actions
-  ACTION initfcdb(const fc_dbond& bond);
+  // collateral is the fiat bond info the emitent expects at bond.collateral_isin
+  ACTION initfcdb(const fc_dbond& bond, const fiat_bond& collateral);
 
   ACTION verifyfcdb(name from, dbond_id_class dbond_id);
 
   ACTION issuefcdb(name from, dbond_id_class dbond_id);
+
+  // series of dbonds differing only by fc_dbond_delta fields
+  ACTION initfcdbs(const fc_dbond& bond, const fiat_bond& collateral, const vector<fc_dbond_delta>& series);
+
+  ACTION verifyfcdbs(name from, const vector<dbond_id_class>& dbond_ids);
+
+  ACTION issuefcdbs(name from, const vector<dbond_id_class>& dbond_ids);
   
   ACTION burn(name from, dbond_id_class dbond_id);
 
-  ACTION updfcdb(dbond_id_class dbond_id);
+#ifndef NO_CC_DBONDS
+  // crypto-collateralized dbond actions, collateral is held in pooled vaults
+  ACTION initccdb(const cc_dbond& bond);
+
+  ACTION lockccdb(dbond_id_class dbond_id);
+
+  ACTION issueccdb(dbond_id_class dbond_id);
+
+  ACTION updccdb(dbond_id_class dbond_id);
+
+  ACTION redeemccdb(name holder, dbond_id_class dbond_id);
+
+  ACTION releaseccdb(dbond_id_class dbond_id);
+
+  ACTION withdraw(name owner, const extended_asset& quantity);
+#endif
+
+#ifndef NO_BASKETS
+  // basket tokens wrapping fixed amounts of fc dbonds
+  ACTION initbasket(name issuer, asset maximum_supply, const vector<asset>& components);
+
+  ACTION mintbasket(name owner, asset quantity);
+
+  ACTION redeembasket(name owner, asset quantity);
+
+  // value of one whole basket by current prices of its dbonds
+  [[eosio::action]] extended_asset basketprice(dbond_id_class basket_id);
+#endif
+
+  [[eosio::action]] uint64_t updfcdb(dbond_id_class dbond_id);
 
   ACTION confirmfcdb(dbond_id_class dbond_id);
 
   ACTION del(dbond_id_class dbond_id);
 
+  // allowlist of holders beyond holders_list, committed as a Merkle root
+  ACTION setholdroot(dbond_id_class dbond_id, const checksum256& root);
+
+  ACTION proveholder(name account, dbond_id_class dbond_id, const vector<checksum256>& proof);
+
+#ifndef NO_PRIVATE_ORDERS
   ACTION listprivord(dbond_id_class dbond_id, name seller, name buyer, extended_asset recieved_asset, bool is_sell);
 
+  // netting of private trades matched within one transaction
+  ACTION netbegin(name initiator);
+
+  ACTION netsettle();
+#endif
+
+  ACTION migratefcdb(name emitent, dbond_id_class dbond_id);
+
+  [[eosio::action]] uint64_t gc(dbond_id_class dbond_id, uint32_t max_rows);
+
+  // returns the number of rows erased
+  [[eosio::action]] uint32_t gcfinal(uint32_t max_rows);
+
+  // notification subscriptions
+  ACTION subscribe(name account, uint8_t events, bool batched);
+
+  ACTION logevents(const vector<event_note>& events);
+
+  // event log
+  ACTION setevlog(uint32_t capacity);
+
+  // read-only, returns price history points within [from, to]
+  [[eosio::action]] vector<price_point> gethist(dbond_id_class dbond_id, time_point_sec from, time_point_sec to);
+
+  // read-only, holders of a dbond in account name order starting at lower_bound, at most limit
+  [[eosio::action]] vector<holder_balance> getholders(dbond_id_class dbond_id, name lower_bound, uint32_t limit);
+
+  // read-only, at most limit holders of a dbond with the largest balances, largest first
+  [[eosio::action]] vector<holder_balance> topholders(dbond_id_class dbond_id, uint32_t limit);
+
+  // fills the holders index from balances which existed before it
+  ACTION syncholders(dbond_id_class dbond_id, const vector<name>& holders);
+
+  // sharded deployment, this instance owns dbond ids with utility::shard_of(id, count) == index
+  ACTION setshard(uint32_t index, uint32_t count);
+
+  // fiat bonds registry actions
+  ACTION regfiatbond(name payer, const fiat_bond& bond);
+
+  ACTION delfiatbond(uint64_t isin);
+
 #ifdef DEBUG    
   ACTION erase(vector<name> holders, dbond_id_class dbond_id);
   ACTION setstate(dbond_id_class dbond_id, int state);
+  ACTION unindex(dbond_id_class dbond_id, name holder);
 private:
   template<class T>
   int erase_table(int64_t scope) {
@@ -98,24 +258,262 @@ private:
     time_point           initial_time;
     extended_asset       initial_price;
     extended_asset       current_price;
+    uint8_t              state_flags;         // low 4 bits: utility::fcdb_state, bit 4: confirmed by counterparty
+    int64_t              unit;                // amount of one whole dbond, 10^precision cached for trades
+
+    uint64_t primary_key() const { return dbond.dbond_id.raw(); }
+
+    utility::fcdb_state state() const { return utility::fcdb_state(state_flags & STATE_MASK); }
+    bool confirmed_by_counterparty() const { return state_flags & CONFIRMED_FLAG; }
+
+    void set_state(utility::fcdb_state new_state) { state_flags = (state_flags & ~STATE_MASK) | uint8_t(new_state); }
+    void set_confirmed_by_counterparty() { state_flags |= CONFIRMED_FLAG; }
+
+    static constexpr uint8_t STATE_MASK     = 0x0f;
+    static constexpr uint8_t CONFIRMED_FLAG = 0x10;
+  };
+
+  // scope: _self
+  // collateral info shared by all fc dbonds backed by the same fiat bond
+  TABLE fiat_bond_stats {
+    fiat_bond            bond;
+    uint32_t             ref_count;           // number of fc dbonds referencing the bond
+    name                 registrant;          // account which registered it, may change or delete it with dBonds
+
+    uint64_t primary_key() const { return bond.ISIN; }
+  };
+
+  // fc_dbond_stats row layout before fixed-width fields, read only by migratefcdb
+  struct fc_dbond_stats_v0 {
+    // dbond
+    dbond_id_class       dbond_id;
+    name                 emitent;
+    asset                quantity_to_issue;
+    time_point           maturity_time;
+    time_point           retire_time;
+    extended_asset       payoff_price;
+    bool                 fungible;
+    string               additional_info;
+    // fiat_bond
+    string               ISIN;
+    string               collateral_name;
+    string               collateral_issuer;
+    string               currency;
+    time_point           collateral_maturity_time;
+    string               bond_description_webpage;
+    // fc_dbond
+    name                 verifier;
+    name                 counterparty;
+    name                 liquidation_agent;
+    string               escrow_contract_link;
+    int64_t              apr;
+    vector<name>         holders_list;
+    // fc_dbond_stats
+    time_point           initial_time;
+    extended_asset       initial_price;
+    extended_asset       current_price;
     int                  fc_state;
     int                  confirmed_by_counterparty;
 
+    EOSLIB_SERIALIZE(fc_dbond_stats_v0, (dbond_id)(emitent)(quantity_to_issue)(maturity_time)(retire_time)
+      (payoff_price)(fungible)(additional_info)(ISIN)(collateral_name)(collateral_issuer)(currency)
+      (collateral_maturity_time)(bond_description_webpage)(verifier)(counterparty)(liquidation_agent)
+      (escrow_contract_link)(apr)(holders_list)(initial_time)(initial_price)(current_price)(fc_state)
+      (confirmed_by_counterparty))
+  };
+
+  // scope: _self
+  // state of every fc dbond, lets sweeps walk dbonds of all emitents ordered by state
+  TABLE fc_dbond_state {
+    dbond_id_class       dbond_id;
+    name                 emitent;
+    uint8_t              state;
+
+    uint64_t primary_key() const { return dbond_id.raw(); }
+    uint64_t by_state() const { return state_key(utility::fcdb_state(state), dbond_id); }
+  };
+
+  // scope: _self
+  // accounts are notified only about events they are subscribed to
+  TABLE subscription {
+    name                 account;
+    uint8_t              events;              // utility::event_type flags
+    bool                 batched;             // listed in logevents instead of direct notification
+
+    uint64_t primary_key() const { return account.value; }
+  };
+
+  // scope: dbond_id (token symbol code)
+  // reverse index of accounts: a row for every account having a balance row of the token,
+  //   kept in step by add_balance, sub_balance and the actions erasing balance rows
+  TABLE holding {
+    name                 holder;
+    int64_t              amount;
+
+    uint64_t primary_key() const { return holder.value; }
+    // largest balance first, zero balances last
+    uint64_t by_balance() const { return uint64_t(std::numeric_limits<int64_t>::max() - amount); }
+  };
+
+  // scope: _self
+  // event log ring buffer, record with sequence number seq lives in slot seq % capacity
+  TABLE event_record {
+    uint64_t             slot;
+    uint64_t             seq;
+    time_point_sec       time;
+    uint8_t              type;                // utility::log_type
+    dbond_id_class       dbond_id;
+    name                 account;
+    name                 counterparty;
+    int64_t              amount;
+    extended_asset       value;
+
+    uint64_t primary_key() const { return slot; }
+    uint64_t by_seq() const { return seq; }
+  };
+
+  // scope: dbond_id
+  // price history, up to utility::price_chunk_samples samples per row; samples after the
+  //   first are stored as varint deltas of time and price from the previous sample
+  TABLE price_chunk {
+    time_point_sec       first_time;
+    int64_t              first_price;
+    time_point_sec       last_time;
+    int64_t              last_price;
+    uint32_t             number;              // sequential number of the chunk
+    uint8_t              samples;
+    vector<char>         deltas;
+
+    uint64_t primary_key() const { return first_time.sec_since_epoch(); }
+  };
+
+  // scope: _self
+  TABLE event_log_state {
+    uint64_t             next_seq;
+    uint32_t             capacity;
+  };
+
+  // scope: _self
+  // absent in a single instance deployment
+  TABLE shard_config {
+    uint32_t             index;
+    uint32_t             count;
+  };
+
+  // scope: _self
+  // progress of gcfinal on the dbond being erased
+  TABLE gc_cursor {
+    dbond_id_class       dbond_id;
+    uint8_t              stage;
+  };
+
+  enum gc_stage: uint8_t {
+    GC_ORDERS = 0,
+    GC_ACCOUNTS = 1,
+    GC_PROVEN = 2,
+    GC_HISTORY = 3,
+    GC_INFO = 4
+  };
+
+  // scope: _self
+  // Merkle root of accounts allowed to hold the dbond in addition to holders_list,
+  //   leaves are sha256 of account name value, pairs are hashed in sorted order
+  TABLE holder_root {
+    dbond_id_class       dbond_id;
+    checksum256          root;
+    uint32_t             version;             // increased with each new root
+
+    uint64_t primary_key() const { return dbond_id.raw(); }
+  };
+
+  // scope: dbond_id
+  // accounts which have proven membership in holder_root, valid while version matches
+  TABLE proven_holder {
+    name                 account;
+    uint32_t             version;
+
+    uint64_t primary_key() const { return account.value; }
+  };
+
+#ifndef NO_CC_DBONDS
+  // scope: dbond.emitent
+  // rows of the other bond types mirror fc_dbond_stats so that the lifecycle templates
+  //   work on any of them
+  TABLE cc_dbond_stats {
+    cc_dbond             dbond;
+    time_point           initial_time;
+    extended_asset       initial_price;
+    extended_asset       current_price;
+    uint8_t              state_flags;
+    uint64_t             vault_id;            // vault of dbond.crypto_collateral
+    uint64_t             collateral_shares;   // vault shares locked under the dbond
+
     uint64_t primary_key() const { return dbond.dbond_id.raw(); }
+
+    utility::fcdb_state state() const { return utility::fcdb_state(state_flags & fc_dbond_stats::STATE_MASK); }
+    void set_state(utility::fcdb_state new_state) { state_flags = (state_flags & ~fc_dbond_stats::STATE_MASK) | uint8_t(new_state); }
+  };
+
+  // scope: _self
+  // collateral of all cc dbonds and claims in one token, split into shares
+  TABLE vault {
+    uint64_t             id;
+    extended_asset       balance;             // tokens held by the contract for the vault
+    uint64_t             total_shares;        // locked under dbonds and owned as claims
+
+    uint64_t primary_key() const { return id; }
+    uint128_t by_token() const { return concat128(balance.contract.value, balance.quantity.symbol.raw()); }
+  };
+
+  // scope: owner
+  // vault shares owned by an account, paid out to it by withdraw action
+  TABLE claim {
+    uint64_t             vault_id;
+    uint64_t             shares;
+
+    uint64_t primary_key() const { return vault_id; }
+  };
+#endif
+
+#ifndef NO_BASKETS
+  // scope: _self
+  TABLE basket {
+    dbond_id_class            basket_id;
+    extended_symbol           currency;       // payoff currency shared by the dbonds
+    vector<basket_component>  components;
+
+    uint64_t primary_key() const { return basket_id.raw(); }
+  };
+
+  // scope: _self
+  // dbonds held by dBonds for all baskets; when the dbond is retired they are bought
+  //   off like the holders' ones and baskets are redeemed into the payoff instead
+  TABLE basket_lock {
+    dbond_id_class       dbond_id;
+    int64_t              locked;
+    bool                 retired;
+    extended_asset       payoff;              // left for the locked dbonds, once retired
+
+    uint64_t primary_key() const { return dbond_id.raw(); }
   };
+#endif
+
+  // rows of types without actions yet are plain structs, they become TABLEs with them
+  // scope: dbond.emitent
+  struct nc_dbond_stats {
+    ::dbond              dbond;
+    time_point           initial_time;
+    extended_asset       initial_price;
+    extended_asset       current_price;
+    uint8_t              state_flags;
 
-  // TABLE cc_dbond_stats {
-  //   dbond_id_class  dbond_id;
-    
-  //   uint64_t primary_key() const { return dbond_id.raw(); }
-  // };
+    uint64_t primary_key() const { return dbond.dbond_id.raw(); }
 
-  // TABLE nc_dbond_stats {
-  //   dbond_id_class  dbond_id;
-    
-  //   uint64_t primary_key() const { return dbond_id.raw(); }
-  // };
+    utility::fcdb_state state() const { return utility::fcdb_state(state_flags & fc_dbond_stats::STATE_MASK); }
+    void set_state(utility::fcdb_state new_state) { state_flags = (state_flags & ~fc_dbond_stats::STATE_MASK) | uint8_t(new_state); }
+  };
 
+#ifndef NO_PRIVATE_ORDERS
   // scope: dbond_id
   TABLE fc_dbond_order_struct {
     name           seller;
@@ -129,15 +527,144 @@ private:
 
   };
 
-  using stats             = multi_index< "stat"_n, currency_stats >;
-  using accounts          = multi_index< "accounts"_n, account >;
-  using fc_dbond_index    = multi_index< "fcdbond"_n, fc_dbond_stats >;
-  // using cc_dbond_index = multi_index< "ccdbond"_n, cc_dbond_stats >;
-  // using nc_dbond_index = multi_index< "ncdbond"_n, nc_dbond_stats >;
-  using fc_dbond_orders   = multi_index<
+  // scope: _self
+  // open netting session; trades matched in its transaction are paid out by netsettle
+  TABLE net_session {
+    checksum256          trx_id;
+    name                 initiator;
+    uint32_t             trades;
+    vector<name>         accounts;            // scopes of net_delta rows
+  };
+
+  // scope: account
+  // amount owed to the account by the trades of the netting session
+  TABLE net_delta {
+    uint64_t             id;
+    extended_asset       amount;
+
+    uint64_t primary_key() const { return id; }
+    uint128_t by_asset() const { return concat128(amount.contract.value, amount.quantity.symbol.raw()); }
+  };
+#endif
+
+  using stats             = DBONDS_MULTI_INDEX< "stat"_n, currency_stats >;
+  using accounts          = DBONDS_MULTI_INDEX< "accounts"_n, account >;
+  using fc_dbond_index    = DBONDS_MULTI_INDEX< "fcdbond"_n, fc_dbond_stats >;
+  using fiat_bonds        = DBONDS_MULTI_INDEX< "fiatbonds"_n, fiat_bond_stats >;
+  using fc_dbond_states   = DBONDS_MULTI_INDEX<
+    "fcdbstates"_n,
+    fc_dbond_state,
+    indexed_by< "bystate"_n, const_mem_fun<fc_dbond_state, uint64_t, &fc_dbond_state::by_state> > >;
+  using gc_cursor_singleton = singleton< "gccursor"_n, gc_cursor >;
+  using shard_config_singleton = singleton< "shardconfig"_n, shard_config >;
+  using subscriptions     = DBONDS_MULTI_INDEX< "subscription"_n, subscription >;
+  using event_log         = DBONDS_MULTI_INDEX<
+    "eventlog"_n,
+    event_record,
+    indexed_by< "byseq"_n, const_mem_fun<event_record, uint64_t, &event_record::by_seq> > >;
+  using event_log_singleton = singleton< "evlogstate"_n, event_log_state >;
+  using price_history     = DBONDS_MULTI_INDEX< "pricehist"_n, price_chunk >;
+
+  // kept open for the whole action so that every subscription row is read once
+  subscriptions           subscribers;
+  vector<event_note>      batched_events;
+#ifndef NO_CC_DBONDS
+  using cc_dbond_index    = DBONDS_MULTI_INDEX< "ccdbond"_n, cc_dbond_stats >;
+  using vaults            = DBONDS_MULTI_INDEX<
+    "vaults"_n,
+    vault,
+    indexed_by< "bytoken"_n, const_mem_fun<vault, uint128_t, &vault::by_token> > >;
+  using claims            = DBONDS_MULTI_INDEX< "claims"_n, claim >;
+#endif
+  using holder_roots      = DBONDS_MULTI_INDEX< "holderroot"_n, holder_root >;
+  using proven_holders    = DBONDS_MULTI_INDEX< "provenholder"_n, proven_holder >;
+  using holdings          = DBONDS_MULTI_INDEX<
+    "holders"_n,
+    holding,
+    indexed_by< "bybalance"_n, const_mem_fun<holding, uint64_t, &holding::by_balance> > >;
+  using nc_dbond_index    = DBONDS_MULTI_INDEX< "ncdbond"_n, nc_dbond_stats >;
+#ifndef NO_BASKETS
+  using baskets           = DBONDS_MULTI_INDEX< "baskets"_n, basket >;
+  using basket_locks      = DBONDS_MULTI_INDEX< "basketlocks"_n, basket_lock >;
+#endif
+#ifndef NO_PRIVATE_ORDERS
+  using fc_dbond_orders   = DBONDS_MULTI_INDEX<
     "fcdborders"_n,
     fc_dbond_order_struct,
     indexed_by< "peers"_n, const_mem_fun<fc_dbond_order_struct, uint128_t, &fc_dbond_order_struct::secondary_key_1> > >;
+  using net_session_singleton = singleton< "netsession"_n, net_session >;
+  using net_deltas        = DBONDS_MULTI_INDEX<
+    "netdelta"_n,
+    net_delta,
+    indexed_by< "byasset"_n, const_mem_fun<net_delta, uint128_t, &net_delta::by_asset> > >;
+#endif
+
+  // Bond type engines. Lifecycle code (pricing, state changes, holder checks) is written
+  //   as member templates over an engine; bond_engine supplies the shared logic and calls
+  //   the type's hooks statically, so there is no runtime dispatch and tables of a type
+  //   are instantiated only if some action uses its engine.
+  template<typename Engine>
+  struct bond_engine {
+    // whether account may receive the dbond
+    template<typename Bond>
+    static bool may_hold(const Bond& bond, name account) {
+      if constexpr(Engine::restricted_holders)
+        return std::find(bond.holders_list.begin(), bond.holders_list.end(), account) != bond.holders_list.end();
+      else
+        return true;
+    }
+
+    // state the dbond moves to at time now, paid_off() tells if the emitent holds the whole supply
+    template<typename Row, typename PaidOff>
+    static utility::fcdb_state next_state(const Row& row, time_point now, PaidOff&& paid_off) {
+      return utility::fcdb_state(lifecycle::next_state(lifecycle::state(row.state()),
+        now.time_since_epoch().count(),
+        row.dbond.maturity_time.time_since_epoch().count(),
+        row.dbond.retire_time.time_since_epoch().count(),
+        paid_off));
+    }
+  };
+
+  struct fc_engine : bond_engine<fc_engine> {
+    using bond_type = fc_dbond;
+    using stats_row = fc_dbond_stats;
+    using index     = fc_dbond_index;
+    static constexpr bool restricted_holders = true;
+    static constexpr bool state_indexed      = true;     // listed in fcdbstates, swept by gcfinal
+
+    static extended_asset price(const fc_dbond& bond, time_point now) {
+      return extended_asset(
+        daycount::price(bond.accrual_basis, bond.payoff_price.quantity.amount, bond.apr,
+          now.sec_since_epoch(), bond.maturity_time.sec_since_epoch()),
+        bond.payoff_price.get_extended_symbol());
+    }
+    static name counterparty(const fc_dbond& bond) { return bond.counterparty; }
+  };
+
+#ifndef NO_CC_DBONDS
+  struct cc_engine : bond_engine<cc_engine> {
+    using bond_type = cc_dbond;
+    using stats_row = cc_dbond_stats;
+    using index     = cc_dbond_index;
+    static constexpr bool restricted_holders = false;
+    static constexpr bool state_indexed      = false;
+
+    // bought back at the issue price, the collateral backs it
+    static extended_asset price(const cc_dbond& bond, time_point) { return bond.issue_price; }
+    static name counterparty(const cc_dbond& bond) { return name(); }
+  };
+#endif
+
+  struct nc_engine : bond_engine<nc_engine> {
+    using bond_type = dbond;
+    using stats_row = nc_dbond_stats;
+    using index     = nc_dbond_index;
+    static constexpr bool restricted_holders = false;
+    static constexpr bool state_indexed      = false;
+
+    static extended_asset price(const dbond& bond, time_point) { return bond.payoff_price; }
+    static name counterparty(const dbond& bond) { return name(); }
+  };
 
   static asset get_supply(name token_contract_account, symbol_code sym_code)
   {
@@ -163,20 +690,71 @@ private:
     return ((uint128_t)x << 64) + (uint128_t)y;
   }
 
+  // symbol code takes at most 7 bytes, so state fits into the highest one
+  static uint64_t state_key(utility::fcdb_state state, dbond_id_class dbond_id) {
+    return (uint64_t(state) << 56) | dbond_id.raw();
+  }
+
+  void notify(name account, utility::event_type event, dbond_id_class dbond_id);
+  void flush_events();
+  void log_event(utility::log_type type, dbond_id_class dbond_id, name account, name counterparty,
+    int64_t amount, const extended_asset& value);
   void change_fcdb_state(dbond_id_class dbond_id, utility::fcdb_state new_state);
-  void sub_balance(name owner, asset value);
+  template<typename Engine> uint64_t change_state(dbond_id_class dbond_id, utility::fcdb_state new_state);
+  template<typename Engine> uint64_t update_bond(dbond_id_class dbond_id);
+  template<typename Engine> void check_holder(dbond_id_class dbond_id, name to);
+  uint64_t sub_balance(name owner, asset value, bool erase_zero = false);
   void add_balance(name owner, asset value, name ram_payer);
+  void add_balance(accounts& to_acnts, asset value, name ram_payer);
+  uint64_t update_holding(name holder, const asset& balance, name ram_payer);
+  uint64_t erase_holding(name holder, symbol_code code);
   void check_on_transfer(name from, name to, asset quantity, const string& memo);
   void check_on_fcdb_transfer(name from, name to, asset quantity, const string& memo);
+  void check_receiver(name issuer, name to, const asset& quantity);
+  bool may_hold_fcdb(const fc_dbond& bond, name account);
   void check_fcdb_sanity(const fc_dbond& bond);
-  void set_initial_data(dbond_id_class dbond_id);
+  void check_fcdb_parties_sanity(const fc_dbond& bond);
+  void check_fcdb_terms_sanity(const fc_dbond& bond, const fiat_bond& collateral);
+  bool same_series(const fc_dbond& a, const fc_dbond& b);
+  static bool is_fcdb_row_v0(const vector<char>& row);
+  void create_token(name issuer, asset maximum_supply);
+  void issue_token(name to, asset quantity, const string& memo);
+  void init_fcdb(const fc_dbond& bond);
+  void check_expected_collateral(uint64_t isin, const fiat_bond& collateral);
+  void issue_fcdb(dbond_id_class dbond_id);
+  template<typename Engine> void set_initial_data(dbond_id_class dbond_id);
+  void append_price(dbond_id_class dbond_id, int64_t price);
+  void add_fiat_bond_ref(uint64_t isin);
+  bool release_fiat_bond_ref(uint64_t isin);
   
   void retire_fcdb(dbond_id_class dbond_id, extended_asset total_quantity_sent);
   void force_retire_from_holder(dbond_id_class dbond_id, name holder, extended_asset & left_after_retire);
   void collect_fcdb_on_dbonds_account(dbond_id_class dbond_id);
   void erase_dbond(dbond_id_class dbond_id);
-  void on_final_state(const fc_dbond_stats& fcdb_info);
+  void set_state_index(dbond_id_class dbond_id, name emitent, utility::fcdb_state state);
+  bool erase_state_index(dbond_id_class dbond_id);
+  dbond_id_class next_final_dbond();
+  uint32_t gc_final_dbond(gc_cursor& cursor, uint32_t max_rows);
+  template<typename Engine> uint64_t on_final_state(const typename Engine::stats_row& info);
+  template<typename F> void for_each_holder(const fc_dbond& bond, F&& f);
+#ifndef NO_CC_DBONDS
+  void check_ccdb_sanity(const cc_dbond& bond);
+  uint64_t open_vault(const extended_symbol& token, name payer);
+  void vault_deposit(name owner, const extended_asset& value);
+  void add_claim(name owner, uint64_t vault_id, uint64_t shares, name payer);
+  void sub_claim(name owner, uint64_t vault_id, uint64_t shares);
+#endif
+#ifndef NO_BASKETS
+  int64_t basket_share(const basket_component& component, const asset& quantity);
+  void check_basket_holder(const basket& b, name account);
+  void retire_basket_lock(dbond_id_class dbond_id, const fc_dbond_stats& fcdb_info, extended_asset& left_after_retire);
+#endif
+#ifndef NO_PRIVATE_ORDERS
   void register_private_order_fcdb(dbond_id_class dbond_id, name seller, name buyer, extended_asset recieved_asset, bool is_sell);
   void match_trade(dbond_id_class dbond_id, name seller, name buyer);
+  void add_net_delta(net_session& session, name account, const extended_asset& value);
+  void settle_net_session(const net_session& session);
+  static checksum256 current_trx_id();
+#endif
 
 };
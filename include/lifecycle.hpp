@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * State transitions and retire economics of fc dbonds. The contract moves dbonds through
+ * these rules in updfcdb and pays holders with payoff() on retire; the header does not
+ * depend on eosio so that off-chain tools (tools/montecarlo) simulate the same rules.
+ */
+
+namespace lifecycle {
+
+  // same values as utility::fcdb_state of the contract
+  enum state: uint8_t {
+    CREATED = 0,
+    AGREEMENT_SIGNED = 1,
+    CIRCULATING = 2,
+    EXPIRED_PAID_OFF = 3,
+    EXPIRED_TECH_DEFAULTED = 4,
+    EXPIRED_DEFAULTED = 5
+  };
+
+  constexpr uint8_t state_count = 6;
+
+  constexpr bool is_final(state s) {
+    return s == EXPIRED_PAID_OFF || s == EXPIRED_DEFAULTED;
+  }
+
+  /*
+   * state a dbond in state s moves to at time now; now, maturity and retire are in the
+   * same unit. paid_off() tells if the emitent holds the whole supply at maturity and is
+   * called only then.
+   */
+  template<typename PaidOff>
+  constexpr state next_state(state s, int64_t now, int64_t maturity, int64_t retire, PaidOff&& paid_off) {
+    if(now >= retire)
+      return s == EXPIRED_TECH_DEFAULTED ? EXPIRED_DEFAULTED : s;
+    if(now >= maturity && s == CIRCULATING)
+      return paid_off() ? EXPIRED_PAID_OFF : EXPIRED_TECH_DEFAULTED;
+    return s;
+  }
+
+  // paid for amount smallest dbond units when retired; payoff_price is per whole dbond of unit
+  constexpr int64_t payoff(int64_t amount, int64_t payoff_price, int64_t unit) {
+    return int64_t((__int128)amount * payoff_price / unit);
+  }
+
+} // namespace lifecycle
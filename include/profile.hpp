@@ -0,0 +1,202 @@
+#pragma once
+
+#include <eosio/eosio.hpp>
+#include <eosio/print.hpp>
+
+#include <cstdlib>
+#include <new>
+
+/*
+ * Work counters for the -DPROFILE build.
+ * Contract code has no clock, so instead of timing we count database and
+ * inline-action work done by each action and print the totals when the
+ * outermost action scope ends. Heap use is counted by replacing the global
+ * operator new, so allocations made by malloc directly are not included.
+ * In a regular build every macro expands to nothing and none of the code
+ * below is compiled.
+ */
+
+using namespace eosio;
+
+#ifdef PROFILE
+namespace profile {
+
+  struct counters {
+    uint32_t table_opens    = 0;
+    uint32_t finds          = 0;
+    uint32_t emplaces       = 0;
+    uint32_t modifies       = 0;
+    uint32_t erases         = 0;
+    uint32_t inline_actions = 0;
+    uint32_t notifications  = 0;
+    uint32_t heap_allocs    = 0;
+    uint32_t heap_bytes     = 0;
+  };
+
+  // every action runs in a fresh wasm instance, so globals are per action;
+  // inline keeps a single definition whichever translation units include this
+  inline counters totals;
+  inline int scope_depth = 0;
+
+  struct action_scope {
+    const char* action_name;
+
+    action_scope(const char* n) : action_name(n) { ++scope_depth; }
+
+    // actions called directly from other actions (e.g. updfcdb from transfer)
+    // only add to the totals; the outermost scope reports them
+    ~action_scope() {
+      if(--scope_depth != 0)
+        return;
+      print("\n[profile] ", action_name,
+        ": table_opens=",    totals.table_opens,
+        " finds=",           totals.finds,
+        " emplaces=",        totals.emplaces,
+        " modifies=",        totals.modifies,
+        " erases=",          totals.erases,
+        " inline_actions=",  totals.inline_actions,
+        " notifications=",   totals.notifications,
+        " heap_allocs=",     totals.heap_allocs,
+        " heap_bytes=",      totals.heap_bytes, "\n");
+    }
+  };
+
+  /*
+   * secondary index wrapper, counts lookups and writes made through it
+   */
+  template<typename Index>
+  struct counted_index : Index {
+    counted_index(const Index& idx) : Index(idx) {}
+
+    template<typename K>
+    auto find(const K& key) const {
+      ++totals.finds;
+      return Index::find(key);
+    }
+
+    template<typename K>
+    const auto& get(const K& key, const char* error_msg = "unable to find key") const {
+      ++totals.finds;
+      return Index::get(key, error_msg);
+    }
+
+    template<typename K>
+    auto lower_bound(const K& key) const {
+      ++totals.finds;
+      return Index::lower_bound(key);
+    }
+
+    template<typename K>
+    auto upper_bound(const K& key) const {
+      ++totals.finds;
+      return Index::upper_bound(key);
+    }
+
+    template<typename It, typename Lambda>
+    void modify(It itr, name payer, Lambda&& updater) {
+      ++totals.modifies;
+      Index::modify(itr, payer, std::forward<Lambda>(updater));
+    }
+
+    template<typename It>
+    auto erase(It itr) {
+      ++totals.erases;
+      return Index::erase(itr);
+    }
+  };
+
+  /*
+   * drop-in replacement for eosio::multi_index used by the -DPROFILE build
+   */
+  template<name::raw TableName, typename T, typename... Indices>
+  class counted_multi_index : public eosio::multi_index<TableName, T, Indices...> {
+    using base = eosio::multi_index<TableName, T, Indices...>;
+  public:
+    counted_multi_index(name code, uint64_t scope) : base(code, scope) {
+      ++totals.table_opens;
+    }
+
+    auto find(uint64_t primary) const {
+      ++totals.finds;
+      return base::find(primary);
+    }
+
+    const T& get(uint64_t primary, const char* error_msg = "unable to find key") const {
+      ++totals.finds;
+      return base::get(primary, error_msg);
+    }
+
+    auto lower_bound(uint64_t primary) const {
+      ++totals.finds;
+      return base::lower_bound(primary);
+    }
+
+    auto upper_bound(uint64_t primary) const {
+      ++totals.finds;
+      return base::upper_bound(primary);
+    }
+
+    template<typename Lambda>
+    auto emplace(name payer, Lambda&& constructor) {
+      ++totals.emplaces;
+      return base::emplace(payer, std::forward<Lambda>(constructor));
+    }
+
+    template<typename Lambda>
+    void modify(typename base::const_iterator itr, name payer, Lambda&& updater) {
+      ++totals.modifies;
+      base::modify(itr, payer, std::forward<Lambda>(updater));
+    }
+
+    template<typename Lambda>
+    void modify(const T& obj, name payer, Lambda&& updater) {
+      ++totals.modifies;
+      base::modify(obj, payer, std::forward<Lambda>(updater));
+    }
+
+    auto erase(typename base::const_iterator itr) {
+      ++totals.erases;
+      return base::erase(itr);
+    }
+
+    void erase(const T& obj) {
+      ++totals.erases;
+      base::erase(obj);
+    }
+
+    template<name::raw IndexName>
+    auto get_index() {
+      auto idx = base::template get_index<IndexName>();
+      return counted_index<decltype(idx)>(idx);
+    }
+  };
+
+} // namespace profile
+
+  // wasm memory only grows within an action, so bytes are summed and never subtracted;
+  // replacements of operator new cannot be inline, the profile build links src/dbonds.cpp only
+  void* operator new(size_t size) {
+    ++profile::totals.heap_allocs;
+    profile::totals.heap_bytes += size;
+    return malloc(size);
+  }
+
+  void* operator new[](size_t size) {
+    ++profile::totals.heap_allocs;
+    profile::totals.heap_bytes += size;
+    return malloc(size);
+  }
+
+  void operator delete(void* ptr) noexcept { free(ptr); }
+  void operator delete[](void* ptr) noexcept { free(ptr); }
+  void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+  void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+  #define PROFILE_ACTION(action_name) profile::action_scope profile_scope_(action_name)
+  #define PROFILE_COUNT(counter)      (++profile::totals.counter)
+  #define DBONDS_MULTI_INDEX          profile::counted_multi_index
+#else
+  #define PROFILE_ACTION(action_name)
+  #define PROFILE_COUNT(counter)
+  #define DBONDS_MULTI_INDEX          multi_index
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "utility.hpp"
+
+#include <eosio/eosio.hpp>
+#include <eosio/singleton.hpp>
+
+using namespace eosio;
+using namespace std;
+
+/*
+ * Registry of a sharded dbonds deployment. Each shard is a dbonds instance configured
+ * with setshard(index, count) and listed here at the same index. Clients and other
+ * contracts ask the router which account owns a dbond id and then talk to that shard
+ * directly; payments and payoffs are plain token transfers to the shard account.
+ */
+
+CONTRACT router : public contract {
+public:
+  using contract::contract;
+
+  ACTION setshards(const vector<name>& shards);
+
+  // read-only, returns the dbonds instance owning dbond_id
+  [[eosio::action]] name getshard(symbol_code dbond_id);
+
+private:
+
+  // scope: _self
+  // shards[i] owns dbond ids with utility::shard_of(id, shards.size()) == i
+  TABLE shard_list {
+    vector<name>   shards;
+  };
+
+  using shard_list_singleton = singleton< "shards"_n, shard_list >;
+};
@@ -1,12 +1,17 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <cctype>
 #include <locale>
 #include <cstdlib>
+#include <cstring>
 #include <eosio/asset.hpp>
 #include <eosio/name.hpp>
+#include <eosio/action.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/crypto.hpp>
 
 #define WEEK_uSECONDS microseconds(1000000LL*3600*24*7)
 
@@ -17,9 +22,21 @@ namespace utility {
 
   int max_holders_number = 10;
 
+  size_t max_basket_components = 32;
+
+  // rows returned by one getholders or topholders call
+  uint32_t max_holders_query = 1000;
+
+  // RAM billed per table row on top of its packed data (key_value_object overhead)
+  const uint64_t row_ram_overhead = 112;
+
+  // price history: samples per chunk row and chunk rows kept per dbond
+  const uint8_t price_chunk_samples = 64;
+  const uint32_t price_history_chunks = 64;
+
   using dbond_id_class = symbol_code;
 
-  bool match_icase(const string& memo, const string& pattern) {
+  bool match_icase(string_view memo, string_view pattern) {
     auto i1 = memo.begin();
     auto i2 = pattern.begin();
     for(; i1 != memo.end() && i2 != pattern.end(); i1++, i2++)
@@ -31,7 +48,7 @@ namespace utility {
   /*
    * match string to pattern from the beginning, treat rest of string as dbond_id
    */
-  bool match_memo(const string& memo, const string& pattern, dbond_id_class& dbond_id) {
+  bool match_memo(string_view memo, string_view pattern, dbond_id_class& dbond_id) {
     auto i1 = memo.begin();
     auto i2 = pattern.begin();
     for(; i1 != memo.end() && i2 != pattern.end(); i1++, i2++)
@@ -40,8 +57,7 @@ namespace utility {
     dbond_id = symbol_code();
     if(i1 == memo.end() && i2 == pattern.end())
       return true;
-    string name_str = string{i1, memo.end()};
-    dbond_id = symbol_code(name_str);
+    dbond_id = symbol_code(memo.substr(i1 - memo.begin()));
     return true;
   }
 
@@ -57,31 +73,171 @@ namespace utility {
    * match string to pattern, trying to treat first "?" as dbond_id, second "?" -- as account name
    */
 
-  bool match_memo(const string& memo, const string& pattern, dbond_id_class& dbond_id, name& who) {
+  bool match_memo(string_view memo, string_view pattern, dbond_id_class& dbond_id, name& who) {
     // expected memo: "buy DBONDA from thedeposbank" || "sell DBONDA to thedeposbank"
-    string tokens[4] = {"", "", "", ""};
-    string cur_token = "", dbond_str="", who_str="";
+    string_view tokens[4];
     int n_token = 0;
-    for(size_t i = 0; i < memo.size() + 1 && n_token < 4; ++i){
-      if((i > 0 && memo[i] == ' ' && memo[i-1] != ' ') || i == memo.size()){
-        tokens[n_token] = cur_token;
-        ++n_token;
-        cur_token = "";
+    for(size_t i = 0; i < memo.size() && n_token < 4; ) {
+      if(memo[i] == ' ') {
+        ++i;
+        continue;
       }
-      if(i < memo.size() && memo[i] != ' ')
-        cur_token += memo[i];
+      size_t start = i;
+      while(i < memo.size() && memo[i] != ' ')
+        ++i;
+      tokens[n_token++] = memo.substr(start, i - start);
     }
     if((tokens[0] == "sell" && tokens[2] == "to") || (tokens[0] == "buy" && tokens[2] == "from")){
-      dbond_str = tokens[1];
-      who_str = tokens[3];
-      dbond_id = dbond_id_class(dbond_str);
-      who = name(who_str);
+      dbond_id = dbond_id_class(tokens[1]);
+      who = name(tokens[3]);
       return true;
     }
     else
       return false;
   }
 
+  /*
+   * memo assembled in a stack buffer; token transfer memos are limited to 256 bytes
+   */
+  struct memo_buffer {
+    char   data[256];
+    size_t size = 0;
+
+    memo_buffer& operator<<(string_view s) {
+      size_t n = std::min(s.size(), sizeof(data) - size);
+      memcpy(data + size, s.data(), n);
+      size += n;
+      return *this;
+    }
+
+    memo_buffer& operator<<(symbol_code code) {
+      for(uint64_t v = code.raw(); v != 0 && size < sizeof(data); v >>= 8)
+        data[size++] = char(v & 0xff);
+      return *this;
+    }
+
+    string_view view() const { return string_view(data, size); }
+  };
+
+  /*
+   * inline "transfer" of a token contract, serialized into a stack buffer and sent
+   * without an eosio::action, whose authorization, data and packed copy live on the heap
+   */
+  void send_transfer(name token_contract, name from, name to, const asset& quantity, string_view memo) {
+    // account, name, one permission, data size, then from, to, quantity and memo
+    char buffer[8 + 8 + 1 + 16 + 2 + 8 + 8 + 16 + 2 + 256];
+    uint32_t data_size = 8 + 8 + 16 + (memo.size() < 128 ? 1 : 2) + memo.size();
+    datastream<char*> ds(buffer, sizeof(buffer));
+    ds << token_contract << "transfer"_n << unsigned_int(1) << permission_level{from, "active"_n};
+    ds << unsigned_int(data_size) << from << to << quantity << unsigned_int(memo.size());
+    ds.write(memo.data(), memo.size());
+    internal_use_do_not_use::send_inline(buffer, ds.tellp());
+  }
+
+
+  /*
+   * pack ISIN (12 characters of [0-9A-Z]) into a base-36 number, 36^12 fits into uint64_t
+   */
+  uint64_t isin_code(const string& isin) {
+    check(isin.size() == 12, "ISIN must be 12 characters long");
+    uint64_t code = 0;
+    for(char c : isin) {
+      uint64_t digit = 0;
+      if(c >= '0' && c <= '9')
+        digit = c - '0';
+      else if(c >= 'A' && c <= 'Z')
+        digit = c - 'A' + 10;
+      else
+        check(false, "ISIN may contain only digits and capital letters");
+      code = code * 36 + digit;
+    }
+    return code;
+  }
+
+  bool is_isin(const string& isin) {
+    if(isin.size() != 12)
+      return false;
+    for(char c : isin)
+      if(!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z')))
+        return false;
+    return true;
+  }
+
+  // first 8 bytes of sha256 of s
+  uint64_t hash64(const string& s) {
+    auto bytes = sha256(s.data(), s.size()).extract_as_byte_array();
+    uint64_t h = 0;
+    for(int i = 0; i < 8; i++)
+      h = (h << 8) | bytes[i];
+    return h;
+  }
+
+  /*
+   * ISIN code of a string from rows written before ISINs were validated: a conforming
+   * ISIN packs as isin_code(), anything else maps to a hash above every packed ISIN
+   */
+  uint64_t isin_code_or_hash(const string& isin) {
+    if(is_isin(isin))
+      return isin_code(isin);
+    const uint64_t isin_codes = 4738381338321616896ull;     // 36^12
+    return isin_codes + hash64(isin) % (~uint64_t(0) - isin_codes);
+  }
+
+  /*
+   * currency code of a string from rows written before currencies were validated:
+   * 1-7 capital letters are taken as they are, anything else becomes 7 letters of its hash
+   */
+  symbol_code currency_code_or_hash(const string& currency) {
+    bool valid = !currency.empty() && currency.size() <= 7;
+    for(char c : currency)
+      valid = valid && c >= 'A' && c <= 'Z';
+    if(valid)
+      return symbol_code(currency);
+    uint64_t h = hash64(currency);
+    string code(7, 'A');
+    for(char& c : code) {
+      c = char('A' + h % 26);
+      h /= 26;
+    }
+    return symbol_code(code);
+  }
+
+  /*
+   * signed LEB128 varint with zigzag encoding, small deltas of either sign take one byte
+   */
+  void put_varint(vector<char>& out, int64_t value) {
+    uint64_t v = (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+    while(v >= 0x80) {
+      out.push_back(char(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back(char(v));
+  }
+
+  int64_t get_varint(const vector<char>& in, size_t& pos) {
+    uint64_t v = 0;
+    for(int shift = 0; pos < in.size(); shift += 7) {
+      uint8_t byte = in[pos++];
+      v |= uint64_t(byte & 0x7f) << shift;
+      if(!(byte & 0x80))
+        break;
+    }
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+  }
+
+  /*
+   * shard owning the dbond id in a deployment of count dbonds instances;
+   * raw symbol codes share low bytes, so they are mixed first (splitmix64 finalizer)
+   */
+  uint32_t shard_of(symbol_code dbond_id, uint32_t count) {
+    uint64_t x = dbond_id.raw();
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return uint32_t(x % count);
+  }
 
   uint64_t pow(uint64_t x, uint64_t p) {
     if(p == 0)
@@ -4,6 +4,7 @@
 #include <string>
 #include <cmath>
 #include <algorithm>
+#include <limits>
 #include <eosio/system.hpp>
 
 void dbonds::check_on_transfer(name from, name to, asset quantity, const string& memo) {
@@ -15,8 +16,8 @@ void dbonds::check_on_transfer(name from, name to, asset quantity, const string&
   stats statstable(_self, sym.raw());
   const auto& st = statstable.get(sym.raw(), "no stats for given symbol code");
 
-  require_recipient(from);
-  require_recipient(to);
+  notify(from, utility::EVENT_TRANSFER, sym);
+  notify(to, utility::EVENT_TRANSFER, sym);
   check(quantity.is_valid(), "invalid quantity");
   check(memo.size() <= 256, "memo has more than 256 bytes");
 }
@@ -27,38 +28,106 @@ void dbonds::check_on_fcdb_transfer(name from, name to, asset quantity, const st
   // do standard check and notification
   check_on_transfer(from, to, quantity, memo);
 
-
   // check that the receiver is in holders list
   auto sym = quantity.symbol.code();
   stats statstable(_self, sym.raw());
   const auto& st = statstable.get(sym.raw(), "no stats for given symbol code");
-  fc_dbond_index fcdb_stat(_self, st.issuer.value);
-  const auto& fcdb_info = fcdb_stat.get(sym.raw(), "FATAL ERROR: dbond not found in fc_dbond table");
+  check_receiver(st.issuer, to, quantity);
+}
 
-  bool to_in_holders = false;
-  for(auto acc : fcdb_info.dbond.holders_list){
-    if(to == acc){
-      to_in_holders = true;
-      break;
-    }
+void dbonds::check_receiver(name issuer, name to, const asset& quantity) {
+  // checks that to may hold quantity of an fc dbond, basket or cc dbond
+  auto sym = quantity.symbol.code();
+  fc_dbond_index fcdb_stat(_self, issuer.value);
+  auto fcdb_info = fcdb_stat.find(sym.raw());
+  if(fcdb_info != fcdb_stat.end()) {
+    check(may_hold_fcdb(fcdb_info->dbond, to), "error, trying to send dbond to the one, who is not in the holders_list");
+    check(fcdb_info->dbond.fungible || quantity.amount % fcdb_info->unit == 0,
+      "non-fungible dbond can be transferred only in whole units");
+    return;
+  }
+
+#ifndef NO_BASKETS
+  baskets basket_table(_self, _self.value);
+  auto b = basket_table.find(sym.raw());
+  if(b != basket_table.end()) {
+    check_basket_holder(*b, to);
+    return;
   }
-  check(to_in_holders, "error, trying to send dbond to the one, who is not in the holders_list");
+#endif
+
+#ifndef NO_CC_DBONDS
+  // not an fc dbond
+  check_holder<cc_engine>(sym, to);
+#else
+  check(false, "FATAL ERROR: dbond not found in fc_dbond table");
+#endif
+}
+
+template<typename Engine>
+void dbonds::check_holder(dbond_id_class dbond_id, name to) {
+  // check that the receiver is allowed to hold the dbond
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "no stats for given symbol code");
+  typename Engine::index info_table(_self, st.issuer.value);
+  const auto& info = info_table.get(dbond_id.raw(), "FATAL ERROR: dbond not found in dbond info table");
+
+  check(Engine::may_hold(info.dbond, to), "error, trying to send dbond to the one, who is not in the holders_list");
 }
 
+template<typename Engine>
 void dbonds::set_initial_data(dbond_id_class dbond_id) {
   stats statstable(_self, dbond_id.raw());
   const auto& st = statstable.get(dbond_id.raw(), "no stats for given symbol code");
   
-  fc_dbond_index fcdb_stat(_self, st.issuer.value);
-  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "FATAL ERROR: dbond not found in fc_dbond table");
+  typename Engine::index info_table(_self, st.issuer.value);
+  const auto& info = info_table.get(dbond_id.raw(), "FATAL ERROR: dbond not found in dbond info table");
 
-  fcdb_stat.modify(fcdb_info, _self, [&](auto& s) {
+  info_table.modify(info, _self, [&](auto& s) {
     s.initial_price = s.current_price;
     s.initial_time  = current_time_point();
   });
 }
 
+void dbonds::append_price(dbond_id_class dbond_id, int64_t price) {
+  // ==========================================================================================
+  // || Adds a sample to the last chunk of price history or starts a new chunk.              ||
+  // || Oldest chunk is dropped when there are more than utility::price_history_chunks.      ||
+  // ==========================================================================================
+  price_history history(_self, dbond_id.raw());
+  time_point_sec now = time_point_sec(current_time_point());
+
+  auto last = history.end();
+  if(last != history.begin())
+    --last;
+
+  if(last != history.end() && last->samples < utility::price_chunk_samples) {
+    history.modify(last, same_payer, [&](auto& c) {
+      utility::put_varint(c.deltas, int64_t(now.sec_since_epoch()) - c.last_time.sec_since_epoch());
+      utility::put_varint(c.deltas, price - c.last_price);
+      c.last_time  = now;
+      c.last_price = price;
+      c.samples++;
+    });
+    return;
+  }
+
+  uint32_t number = last == history.end() ? 0 : last->number + 1;
+  if(history.begin() != history.end() && number - history.begin()->number >= utility::price_history_chunks)
+    history.erase(history.begin());
+
+  history.emplace(_self, [&](auto& c) {
+    c.first_time  = now;
+    c.first_price = price;
+    c.last_time   = now;
+    c.last_price  = price;
+    c.number      = number;
+    c.samples     = 1;
+  });
+}
+
 ACTION dbonds::transfer(name from, name to, asset quantity, const string& memo) {
+  PROFILE_ACTION("transfer");
   
   check_on_fcdb_transfer(from, to, quantity, memo);
   
@@ -76,28 +145,114 @@ ACTION dbonds::transfer(name from, name to, asset quantity, const string& memo)
   if(to == _self && utility::match_memo(memo, "retire ", memo_dbond_id)) {
     check(dbond_id == memo_dbond_id, "wrong dbond id");
     retire_fcdb(memo_dbond_id, extended_asset{quantity, _self});
-    return;
   }
+#ifndef NO_PRIVATE_ORDERS
   // somebody sells fcdb
-  if(to == _self && utility::match_memo(memo, "sell ? to ?", memo_dbond_id, buyer)) {
+  else if(to == _self && utility::match_memo(memo, "sell ? to ?", memo_dbond_id, buyer)) {
     check(dbond_id == memo_dbond_id, "wrong dbond id");
-    updfcdb(dbond_id);
+    update_bond<fc_engine>(dbond_id);
     register_private_order_fcdb(memo_dbond_id, from, buyer, extended_asset{quantity, _self}, true);
-    return;
   }
-  
+#endif
+
+  flush_events();
+}
+
+ACTION dbonds::transfers(name from, const vector<transfer_entry>& transfers) {
+  PROFILE_ACTION("transfers");
+  // ==========================================================================================
+  // || Moves dbonds from one account to many in a single action.                            ||
+  // || Entries are grouped by dbond, so every dbond is looked up and checked once, and      ||
+  // ||   each account balance is changed once per dbond.                                    ||
+  // || Memos are not interpreted, sell and retire requests go through transfer action.      ||
+  // ==========================================================================================
+
+  require_auth(from);
+  check(!transfers.empty(), "no transfers given");
+
+  vector<transfer_entry> entries = transfers;
+
+  // debit side: one stats and fc_dbond lookup and one balance change per dbond
+  sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return make_pair(a.quantity.symbol.code(), a.to) < make_pair(b.quantity.symbol.code(), b.to);
+  });
+  for(size_t i = 0; i < entries.size(); ) {
+    symbol sym = entries[i].quantity.symbol;
+
+    stats statstable(_self, sym.code().raw());
+    const auto& st = statstable.get(sym.code().raw(), "no stats for given symbol code");
+    check(sym == st.supply.symbol, "symbol precision mismatch");
+
+    // fc dbonds are checked here with one lookup, baskets and cc dbonds per entry
+    fc_dbond_index fcdb_stat(_self, st.issuer.value);
+    auto fcdb_info = fcdb_stat.find(sym.code().raw());
+
+    asset total{0, sym};
+    for(; i < entries.size() && entries[i].quantity.symbol.code() == sym.code(); i++) {
+      const auto& entry = entries[i];
+      check(entry.to != from, "cannot transfer to self");
+      check(entry.to != _self, "use transfer action to send dbonds to dBonds");
+      check(entry.quantity.is_valid(), "invalid quantity");
+      check(entry.quantity.symbol == sym, "symbol precision mismatch");
+      check(entry.quantity.amount > 0, "must transfer positive quantity");
+      check(entry.memo.size() <= 256, "memo has more than 256 bytes");
+      if(fcdb_info != fcdb_stat.end()) {
+        check(may_hold_fcdb(fcdb_info->dbond, entry.to),
+          "error, trying to send dbond to the one, who is not in the holders_list");
+        check(fcdb_info->dbond.fungible || entry.quantity.amount % fcdb_info->unit == 0,
+          "non-fungible dbond can be transferred only in whole units");
+      }
+      else {
+        check_receiver(st.issuer, entry.to, entry.quantity);
+      }
+      total += entry.quantity;
+    }
+    sub_balance(from, total);
+    notify(from, utility::EVENT_TRANSFER, sym.code());
+  }
+
+  // credit side: one pass over each recipient's balances
+  sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return make_pair(a.to, a.quantity.symbol.code()) < make_pair(b.to, b.quantity.symbol.code());
+  });
+  for(size_t i = 0; i < entries.size(); ) {
+    name to = entries[i].to;
+    check(is_account(to), "to account does not exist");
+
+    auto payer = has_auth(to) ? to : from;
+    accounts to_acnts(_self, to.value);
+    while(i < entries.size() && entries[i].to == to) {
+      asset value = entries[i].quantity;
+      for(i++; i < entries.size() && entries[i].to == to && entries[i].quantity.symbol == value.symbol; i++)
+        value += entries[i].quantity;
+      add_balance(to_acnts, value, payer);
+      notify(to, utility::EVENT_TRANSFER, value.symbol.code());
+    }
+  }
+  flush_events();
 }
 
 ACTION dbonds::create(name issuer, asset maximum_supply) {
+  PROFILE_ACTION("create");
 
   // check(has_auth(_self) || has_auth(DBVERIFIER), "auth required");
   require_auth(_self);
 
+  create_token(issuer, maximum_supply);
+}
+
+void dbonds::create_token(name issuer, asset maximum_supply) {
   auto sym = maximum_supply.symbol;
   check(sym.is_valid(), "invalid dbond name");
   check(maximum_supply.is_valid(), "invalid supply");
   check(maximum_supply.amount > 0, "max-supply must be positive");
 
+  shard_config_singleton shard_table(_self, _self.value);
+  if(shard_table.exists()) {
+    auto shard = shard_table.get();
+    check(utility::shard_of(sym.code(), shard.count) == shard.index, "dbond id belongs to another shard");
+  }
+
   stats statstable(_self, sym.code().raw());
   auto existing = statstable.find(sym.code().raw());
   check(existing == statstable.end(), "dbond with id already exists");
@@ -110,6 +265,15 @@ ACTION dbonds::create(name issuer, asset maximum_supply) {
 }
 
 ACTION dbonds::issue(name to, asset quantity, string memo) {
+  PROFILE_ACTION("issue");
+
+  // allow only inline action calls
+  require_auth(_self);
+
+  issue_token(to, quantity, memo);
+}
+
+void dbonds::issue_token(name to, asset quantity, const string& memo) {
   auto sym = quantity.symbol;
   check(sym.is_valid(), "invalid symbol name");
   check(memo.size() <= 256, "memo has more than 256 bytes");
@@ -119,9 +283,6 @@ ACTION dbonds::issue(name to, asset quantity, string memo) {
   check(existing != statstable.end(), "token with symbol does not exist, create token before issue");
   const auto& st = *existing;
 
-  // allow only inline action calls
-  require_auth(_self);
-
   check(quantity.is_valid(), "invalid quantity");
   check(quantity.amount > 0, "must issue positive quantity");
 
@@ -136,50 +297,130 @@ ACTION dbonds::issue(name to, asset quantity, string memo) {
   // print("\nline: ", __LINE__); check(false, "bye");
 
   if(to != st.issuer) {
+    PROFILE_COUNT(inline_actions);
     SEND_INLINE_ACTION(*this, transfer, {{st.issuer, "active"_n}}, {st.issuer, to, quantity, memo});
   }
 }
 
+uint64_t dbonds::open(name owner, const symbol& symbol, name ram_payer) {
+  PROFILE_ACTION("open");
+  require_auth(ram_payer);
+  check(is_account(owner), "owner account does not exist");
+
+  auto sym_code_raw = symbol.code().raw();
+  stats statstable(_self, sym_code_raw);
+  const auto& st = statstable.get(sym_code_raw, "symbol does not exist");
+  check(st.supply.symbol == symbol, "symbol precision mismatch");
+
+  accounts acnts(_self, owner.value);
+  auto it = acnts.find(sym_code_raw);
+  if(it == acnts.end()) {
+    acnts.emplace(ram_payer, [&](auto& a) {
+      a.balance = asset{0, symbol};
+    });
+    return pack_size(asset{0, symbol}) + utility::row_ram_overhead + update_holding(owner, asset{0, symbol}, ram_payer);
+  }
+  return 0;
+}
+
+uint64_t dbonds::close(name owner, const symbol& symbol) {
+  PROFILE_ACTION("close");
+  require_auth(owner);
+
+  accounts acnts(_self, owner.value);
+  auto it = acnts.find(symbol.code().raw());
+  check(it != acnts.end(), "balance row already deleted or never existed, action won't have any effect");
+  check(it->balance.amount == 0, "cannot close because the balance is not zero");
+
+  uint64_t reclaimed = pack_size(*it) + utility::row_ram_overhead;
+  acnts.erase(it);
+  reclaimed += erase_holding(owner, symbol.code());
+  return reclaimed;
+}
+
 ACTION dbonds::burn(name from, dbond_id_class dbond_id) {}
 
-ACTION dbonds::initfcdb(const fc_dbond& bond) {
+ACTION dbonds::initfcdb(const fc_dbond& bond, const fiat_bond& collateral) {
+  PROFILE_ACTION("initfcdb");
   // ==========================================================================================
   // || Is called several times with auth of dbond.emitent                                   ||
   // || First time is called to reserve dbond_id after the emitent to put it into agreement  ||
   // || Then emitent has to call it once again to specify dbond parameters as in agreement   ||
   // ||   or to fix some mistakes.                                                           ||
   // || Can be called only when dbond is at CREATED state.                                   ||
+  // || collateral must be equal to the registered fiat bond, so that the registry row       ||
+  // ||   cannot be swapped between regfiatbond and initfcdb.                                ||
   // ==========================================================================================
 
   require_auth(bond.emitent);
 
+  check_expected_collateral(bond.collateral_isin, collateral);
+  init_fcdb(bond);
+}
+
+void dbonds::check_expected_collateral(uint64_t isin, const fiat_bond& collateral) {
+  fiat_bonds registry(_self, _self.value);
+  const auto& registered = registry.get(isin, "collateral fiat bond is not registered");
+  check(pack(registered.bond) == pack(collateral), "registered collateral fiat bond differs from the expected one");
+}
+
+void dbonds::init_fcdb(const fc_dbond& bond) {
+  check(bond.quantity_to_issue.symbol.code() == bond.dbond_id, "quantity_to_issue symbol must be the dbond id");
+
   // find dbond in common table
   stats statstable(_self, bond.dbond_id.raw());
   auto dbond_stat = statstable.find(bond.dbond_id.raw());
 
-  // if not exists, call create ACTION
+  // if not exists, create token
   if(dbond_stat == statstable.end()){
-    SEND_INLINE_ACTION(*this, create, {{_self, "active"_n}}, {bond.emitent, bond.quantity_to_issue});
+    create_token(bond.emitent, bond.quantity_to_issue);
+  }
+  else {
+    check(dbond_stat->issuer == bond.emitent, "dbond id is taken by another emitent");
   }
 
+#ifndef NO_CC_DBONDS
+  cc_dbond_index ccdb_stat(_self, bond.emitent.value);
+  check(ccdb_stat.find(bond.dbond_id.raw()) == ccdb_stat.end(), "dbond id is taken by a cc dbond");
+#endif
+#ifndef NO_BASKETS
+  baskets basket_table(_self, _self.value);
+  check(basket_table.find(bond.dbond_id.raw()) == basket_table.end(), "dbond id is taken by a basket");
+#endif
+
   // find dbond in cusom table with all info
   fc_dbond_index fcdb_stat(_self, bond.emitent.value);
   auto fcdb_info = fcdb_stat.find(bond.dbond_id.raw());
 
   if(fcdb_info == fcdb_stat.end()) {
     // new dbond, make a record for it
+    add_fiat_bond_ref(bond.collateral_isin);
     fcdb_stat.emplace(bond.emitent, [&](auto& s) {
       s.dbond        = bond;
       s.initial_time = time_point();
-      s.fc_state     = (int)utility::fcdb_state::CREATED;
+      s.state_flags  = uint8_t(utility::fcdb_state::CREATED);
+      s.unit         = utility::pow(10, bond.quantity_to_issue.symbol.precision());
     });
+    set_state_index(bond.dbond_id, bond.emitent, utility::fcdb_state::CREATED);
   }
   //check state and that previous record was mady by the same accaunt as now
-  else if(fcdb_info->fc_state == (int)utility::fcdb_state::CREATED && fcdb_info->dbond.emitent == bond.emitent) {
+  else if(fcdb_info->state() == utility::fcdb_state::CREATED && fcdb_info->dbond.emitent == bond.emitent) {
     // dbond already exists, but in state CREATED it may be overwritten
+    if(fcdb_info->dbond.collateral_isin != bond.collateral_isin) {
+      add_fiat_bond_ref(bond.collateral_isin);
+      release_fiat_bond_ref(fcdb_info->dbond.collateral_isin);
+    }
     fcdb_stat.modify(fcdb_info, bond.emitent, [&](auto& s) {
       s.dbond      = bond;
+      s.unit       = utility::pow(10, bond.quantity_to_issue.symbol.precision());
     });
+    // token is not issued yet, keep its max supply in line with the dbond
+    if(dbond_stat != statstable.end()) {
+      statstable.modify(dbond_stat, same_payer, [&](auto& s) {
+        s.supply.symbol = bond.quantity_to_issue.symbol;
+        s.max_supply    = bond.quantity_to_issue;
+      });
+    }
   } 
   else {
     check(false, "dbond exists and not in CREATED state, change is not allowed");
@@ -187,6 +428,7 @@ ACTION dbonds::initfcdb(const fc_dbond& bond) {
 }
 
 ACTION dbonds::verifyfcdb(name from, dbond_id_class dbond_id) {
+  PROFILE_ACTION("verifyfcdb");
   // ==========================================================================================
   // || Is called once with dbond.verifier auth                                              ||
   // || This action confirmes that on-chain dbond info agrees with off-chain bond and        ||
@@ -210,15 +452,93 @@ ACTION dbonds::verifyfcdb(name from, dbond_id_class dbond_id) {
   check_fcdb_sanity(fcdb_info.dbond);
 
   change_fcdb_state(dbond_id, utility::fcdb_state::AGREEMENT_SIGNED);
+  flush_events();
 }
 
 ACTION dbonds::issuefcdb(name from, dbond_id_class dbond_id) {
+  PROFILE_ACTION("issuefcdb");
   // =================================================================================
   // || Is called once with dbond.emitent auth after verification by dbond.verifier ||
   // || Changes dbond state from AGREEMENT_SIGNED to CIRCULATING                    ||
   // || Calls dbond update the first time in its lifecycle                          ||
   // =================================================================================
 
+  issue_fcdb(dbond_id);
+  flush_events();
+}
+
+ACTION dbonds::initfcdbs(const fc_dbond& bond, const fiat_bond& collateral, const vector<fc_dbond_delta>& series) {
+  PROFILE_ACTION("initfcdbs");
+  // ==========================================================================================
+  // || Same as initfcdb for every dbond of a series. Each dbond is the given bond with      ||
+  // ||   id, quantity, maturity and pay-off price taken from its series entry.              ||
+  // ==========================================================================================
+
+  require_auth(bond.emitent);
+  check(!series.empty(), "empty series");
+  check_expected_collateral(bond.collateral_isin, collateral);
+
+  fc_dbond item = bond;
+  for(const auto& delta : series) {
+    item.dbond_id          = delta.dbond_id;
+    item.quantity_to_issue = delta.quantity_to_issue;
+    item.maturity_time     = delta.maturity_time;
+    item.payoff_price      = delta.payoff_price;
+    init_fcdb(item);
+  }
+}
+
+ACTION dbonds::verifyfcdbs(name from, const vector<dbond_id_class>& dbond_ids) {
+  PROFILE_ACTION("verifyfcdbs");
+  // ==========================================================================================
+  // || Same as verifyfcdb for every dbond of a series. Parties and holders are checked      ||
+  // ||   once on the first dbond, the rest must share them; terms are checked per dbond.    ||
+  // ==========================================================================================
+
+  check(!dbond_ids.empty(), "empty series");
+
+  fiat_bonds registry(_self, _self.value);
+  fc_dbond head;
+  for(size_t i = 0; i < dbond_ids.size(); i++) {
+    dbond_id_class dbond_id = dbond_ids[i];
+
+    stats statstable(_self, dbond_id.raw());
+    const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+
+    fc_dbond_index fcdb_stat(_self, st.issuer.value);
+    const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "FATAL ERROR: dbond not found in fc_dbond table");
+
+    if(i == 0) {
+      require_auth(fcdb_info.dbond.verifier);
+      check_fcdb_parties_sanity(fcdb_info.dbond);
+      head = fcdb_info.dbond;
+    }
+    else {
+      check(same_series(head, fcdb_info.dbond), "dbond " + dbond_id.to_string() + " has parties or holders different from the series");
+    }
+
+    // rows are cached by the table object, shared collateral is read once
+    const auto& collateral = registry.get(fcdb_info.dbond.collateral_isin, "collateral fiat bond is not registered");
+    check_fcdb_terms_sanity(fcdb_info.dbond, collateral.bond);
+
+    change_fcdb_state(dbond_id, utility::fcdb_state::AGREEMENT_SIGNED);
+  }
+  flush_events();
+}
+
+ACTION dbonds::issuefcdbs(name from, const vector<dbond_id_class>& dbond_ids) {
+  PROFILE_ACTION("issuefcdbs");
+  // ==========================================================================================
+  // || Same as issuefcdb for every dbond of a series, issued in place in one action.        ||
+  // ==========================================================================================
+
+  check(!dbond_ids.empty(), "empty series");
+  for(auto dbond_id : dbond_ids)
+    issue_fcdb(dbond_id);
+  flush_events();
+}
+
+void dbonds::issue_fcdb(dbond_id_class dbond_id) {
   // check bond exists
   stats statstable(_self, dbond_id.raw());
   const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
@@ -231,82 +551,76 @@ ACTION dbonds::issuefcdb(name from, dbond_id_class dbond_id) {
   require_auth(fcdb_info.dbond.emitent);
 
   // check dbond is in state AGREEMENT_SIGNED
-  check(fcdb_info.fc_state == (int)utility::fcdb_state::AGREEMENT_SIGNED, "wrong fc_dbond state to call this ACTION");
+  check(fcdb_info.state() == utility::fcdb_state::AGREEMENT_SIGNED, "wrong fc_dbond state to call this ACTION");
 
-  // call classic action issue
-  SEND_INLINE_ACTION(*this, issue, {{_self, "active"_n}}, {fcdb_info.dbond.emitent, fcdb_info.dbond.quantity_to_issue, std::string{}});
+  // issue the whole quantity to emitent
+  issue_token(fcdb_info.dbond.emitent, fcdb_info.dbond.quantity_to_issue, std::string{});
 
   // change state of dbond according to logic
   change_fcdb_state(dbond_id, utility::fcdb_state::CIRCULATING);
 
   // update dbond price
-  SEND_INLINE_ACTION(*this, updfcdb, {{_self, "active"_n}}, {dbond_id});
+  update_bond<fc_engine>(dbond_id);
 }
 
-ACTION dbonds::updfcdb(dbond_id_class dbond_id) {
+uint64_t dbonds::updfcdb(dbond_id_class dbond_id) {
+  PROFILE_ACTION("updfcdb");
   // ==========================================================
   // || Public action which updates price of dbond and its   ||
   // ||   state depending on time.                           ||
   // || Can be called only if dbond token is already issed   ||
+  // || Returns number of RAM bytes reclaimed from holders   ||
+  // ||   when the dbond reaches a final state.              ||
   // ==========================================================
 
+  uint64_t reclaimed = update_bond<fc_engine>(dbond_id);
+  flush_events();
+  return reclaimed;
+}
+
+template<typename Engine>
+uint64_t dbonds::update_bond(dbond_id_class dbond_id) {
   stats statstable(_self, dbond_id.raw());
   const auto st = statstable.get(dbond_id.raw(), "dbond not found");
 
-  fc_dbond_index fcdb_stat(_self, st.issuer.value);
-  auto fcdb_info = fcdb_stat.find(dbond_id.raw());
-  check(fcdb_info != fcdb_stat.end(), "FATAL ERROR: dbond not found in fc_dbond table");
-  check(fcdb_info->fc_state >= (int)utility::fcdb_state::CIRCULATING, "update of dbond univailable, need to issue it first");
+  typename Engine::index info_table(_self, st.issuer.value);
+  auto info = info_table.find(dbond_id.raw());
+  check(info != info_table.end(), "FATAL ERROR: dbond not found in dbond info table");
+  check(info->state() >= utility::fcdb_state::CIRCULATING, "update of dbond univailable, need to issue it first");
 
   // update price
-  uint32_t maturity_time = fcdb_info->dbond.maturity_time.sec_since_epoch();
-  uint32_t current_time = current_time_point().sec_since_epoch();
-  int64_t s_to_maturity = (maturity_time - current_time);
-  int64_t s_in_year = 365LL * 24 * 60 * 60;
-  double cur_price = 0;
-  if(s_to_maturity > 0){
-    double b = 1.0 * fcdb_info->dbond.payoff_price.quantity.amount;
-    double apr = 1.0 * fcdb_info->dbond.apr;
-    cur_price = b / (1. + apr / 1e4 * s_to_maturity / s_in_year);
-  }
+  time_point now = current_time_point();
+  extended_asset new_price = Engine::price(info->dbond, now);
 
-  extended_asset new_price = extended_asset((int64_t)(cur_price+0.99), fcdb_info->dbond.payoff_price.get_extended_symbol());
+  if(new_price != info->current_price)
+    append_price(dbond_id, new_price.quantity.amount);
 
-  fcdb_stat.modify(fcdb_info, same_payer, [&](auto& a) {
+  info_table.modify(info, same_payer, [&](auto& a) {
       a.current_price = new_price;
   });
 
-  if(fcdb_info->initial_price.quantity.amount == 0) {
+  if(info->initial_price.quantity.amount == 0) {
     // set initial time and price
-    set_initial_data(dbond_id);
+    set_initial_data<Engine>(dbond_id);
   }
 
   // update state
-  time_point now = current_time_point();
-  if(now >= fcdb_info->dbond.retire_time) {
-    if(fcdb_info->fc_state == (int)utility::fcdb_state::EXPIRED_TECH_DEFAULTED) {
-      change_fcdb_state(dbond_id, utility::fcdb_state::EXPIRED_DEFAULTED);
-    }
-    return;
-  }
-  if(now >= fcdb_info->dbond.maturity_time &&
-      fcdb_info->fc_state == (int)utility::fcdb_state::CIRCULATING) {
-    if(get_balance(_self, fcdb_info->dbond.emitent, dbond_id) == st.supply) {
-      change_fcdb_state(dbond_id, utility::fcdb_state::EXPIRED_PAID_OFF);
-    }
-    else {
-      change_fcdb_state(dbond_id, utility::fcdb_state::EXPIRED_TECH_DEFAULTED);
-    }
-  }
+  utility::fcdb_state new_state = Engine::next_state(*info, now, [&]() {
+    return get_balance(_self, info->dbond.emitent, dbond_id) == st.supply;
+  });
+  if(new_state != info->state())
+    return change_state<Engine>(dbond_id, new_state);
+  return 0;
 }
 
 ACTION dbonds::confirmfcdb(dbond_id_class dbond_id) {
+  PROFILE_ACTION("confirmfcdb");
   // =====================================================================================
   // || Is called with dbond.counterparty auth                                          ||
   // || This action is called from counterparty dbond validaton action and              ||
   // ||   notifies the dbonds contract that it was successfully validated.              ||
   // || Holds only informative function, so that all dbond info obesrvable in one       ||
-  // ||   place including "confirmed_by_counterparty" field                             ||
+  // ||   place including "confirmed_by_counterparty" flag                              ||
   // =====================================================================================
   stats statstable(_self, dbond_id.raw());
   const auto st = statstable.get(dbond_id.raw(), "dbond not found");
@@ -319,18 +633,19 @@ ACTION dbonds::confirmfcdb(dbond_id_class dbond_id) {
   require_auth(fcdb_info->dbond.counterparty);
 
   // check that is not confirmed yet
-  check(fcdb_info->confirmed_by_counterparty != 1, "dbond is already confirmed by counterparty");
+  check(!fcdb_info->confirmed_by_counterparty(), "dbond is already confirmed by counterparty");
 
   // check that dbond is verified and would not change
-  check(fcdb_info->fc_state >= (int)utility::fcdb_state::AGREEMENT_SIGNED, "dbond is not verified");
+  check(fcdb_info->state() >= utility::fcdb_state::AGREEMENT_SIGNED, "dbond is not verified");
 
   // change make confirmation
   fcdb_stat.modify(fcdb_info, same_payer, [&](auto& stat) {
-    stat.confirmed_by_counterparty = 1;
+    stat.set_confirmed_by_counterparty();
   });
 }
 
 ACTION dbonds::del(dbond_id_class dbond_id) {
+  PROFILE_ACTION("del");
   // =====================================================================================
   // || If called with dbond.emitent auth:                                              ||
   // || If dbond token was not issued, emitent can release the memory by deleting       ||
@@ -350,12 +665,88 @@ ACTION dbonds::del(dbond_id_class dbond_id) {
     erase_dbond(dbond_id);
   else {
     require_auth(fcdb_info.dbond.emitent);
-    check(fcdb_info.fc_state < (int)utility::fcdb_state::CIRCULATING, "emitent can erase token only if it is not issued yet");
+    check(fcdb_info.state() < utility::fcdb_state::CIRCULATING, "emitent can erase token only if it is not issued yet");
     erase_dbond(dbond_id);
   }
 }
 
+ACTION dbonds::setholdroot(dbond_id_class dbond_id, const checksum256& root) {
+  PROFILE_ACTION("setholdroot");
+  // ==========================================================================================
+  // || Is called by dbond.verifier to commit Merkle root of accounts allowed to hold the    ||
+  // ||   dbond besides holders_list. A new root invalidates all earlier proofs.             ||
+  // ==========================================================================================
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+  fc_dbond_index fcdb_stat(_self, st.issuer.value);
+  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "FATAL ERROR: dbond not found in fc_dbond table");
+
+  require_auth(fcdb_info.dbond.verifier);
+  check(!utility::is_final_state(fcdb_info.state()), "dbond is in final state");
+
+  holder_roots roots(_self, _self.value);
+  auto existing = roots.find(dbond_id.raw());
+  if(existing == roots.end()) {
+    roots.emplace(fcdb_info.dbond.verifier, [&](auto& r) {
+      r.dbond_id = dbond_id;
+      r.root     = root;
+      r.version  = 1;
+    });
+  }
+  else {
+    roots.modify(existing, same_payer, [&](auto& r) {
+      r.root = root;
+      r.version++;
+    });
+  }
+}
+
+ACTION dbonds::proveholder(name account, dbond_id_class dbond_id, const vector<checksum256>& proof) {
+  PROFILE_ACTION("proveholder");
+  // ==========================================================================================
+  // || Checks Merkle proof that account is in the holder allowlist of the dbond and caches  ||
+  // ||   the result, so that transfers to the account are checked with one lookup.         ||
+  // || Proof is the list of sibling hashes from the leaf up. RAM is billed to the account.  ||
+  // ==========================================================================================
+
+  require_auth(account);
+
+  holder_roots roots(_self, _self.value);
+  const auto& root = roots.get(dbond_id.raw(), "dbond has no holder allowlist");
+  check(proof.size() <= 32, "proof is too long");
+
+  checksum256 hash = sha256(reinterpret_cast<const char*>(&account.value), sizeof(account.value));
+  for(const auto& sibling : proof) {
+    auto a = hash.extract_as_byte_array();
+    auto b = sibling.extract_as_byte_array();
+    if(b < a)
+      swap(a, b);
+    std::array<uint8_t, 64> pair;
+    copy(a.begin(), a.end(), pair.begin());
+    copy(b.begin(), b.end(), pair.begin() + 32);
+    hash = sha256(reinterpret_cast<const char*>(pair.data()), pair.size());
+  }
+  check(hash == root.root, "account is not in the holder allowlist");
+
+  proven_holders proven(_self, dbond_id.raw());
+  auto existing = proven.find(account.value);
+  if(existing == proven.end()) {
+    proven.emplace(account, [&](auto& p) {
+      p.account = account;
+      p.version = root.version;
+    });
+  }
+  else {
+    proven.modify(existing, same_payer, [&](auto& p) {
+      p.version = root.version;
+    });
+  }
+}
+
+#ifndef NO_PRIVATE_ORDERS
 ACTION dbonds::listprivord(dbond_id_class dbond_id, name seller, name buyer, extended_asset recieved_asset, bool is_sell) {
+  PROFILE_ACTION("listprivord");
   // ==========================================================================================
   // || Is called with _self authorization as a separate action to send notification further ||
   // || Is called from transfer action or from transfer notification with _self as recipient ||
@@ -395,7 +786,7 @@ ACTION dbonds::listprivord(dbond_id_class dbond_id, name seller, name buyer, ext
     });
 
     // send notification to counterparty
-    require_recipient(is_sell ? buyer : seller);
+    notify(is_sell ? buyer : seller, utility::EVENT_ORDER, dbond_id);
   }
   else {
     // if got here from second order request from holder need to fail
@@ -414,136 +805,1207 @@ ACTION dbonds::listprivord(dbond_id_class dbond_id, name seller, name buyer, ext
     // when all fields are filled, we match the trade
     match_trade(dbond_id, seller, buyer);
   }
-  
+  flush_events();
 }
 
-#ifdef DEBUG
-/*
- * Erase all given scopes
- */
-ACTION dbonds::erase(vector<name> holders, dbond_id_class dbond_id) {
-  require_auth(_self);
-  // stats:
-  erase_table<stats>(dbond_id.raw());
-  // accounts:
-  for(auto holder : holders) {
-    erase_table<accounts>(holder.value);
-    require_recipient(holder);
+ACTION dbonds::netbegin(name initiator) {
+  PROFILE_ACTION("netbegin");
+  // ==========================================================================================
+  // || Opens a netting session for the transaction it is called in. Private trades matched  ||
+  // ||   later in the same transaction do not pay out, their payments, changes and dbonds   ||
+  // ||   are summed per (account, asset) and paid by netsettle with one transfer each.      ||
+  // || Dbonds bought in the session are not spendable before netsettle.                     ||
+  // || There is one session at a time. A session left open by an earlier transaction is    ||
+  // ||   settled here first, so it never blocks the next one.                               ||
+  // ==========================================================================================
+
+  require_auth(initiator);
+
+  net_session_singleton session_table(_self, _self.value);
+  if(session_table.exists()) {
+    net_session stale = session_table.get();
+    check(stale.trx_id != current_trx_id(), "netting session is open in this transaction already");
+    settle_net_session(stale);
   }
-  // fc_dbond_index:
-  for(auto holder : holders)
-    erase_table<fc_dbond_index>(holder.value);
-  // fc_dbond_orders:
-  erase_table<fc_dbond_orders>(dbond_id.raw());
-}
 
-ACTION dbonds::setstate(dbond_id_class dbond_id, int state) {
-  require_auth(_self);
-  stats statstable(_self, dbond_id.raw());
-  const auto& st = statstable.get(dbond_id.raw());
+  net_session session;
+  session.trx_id    = current_trx_id();
+  session.initiator = initiator;
+  session.trades    = 0;
+  session_table.set(session, _self);
+}
 
-  fc_dbond_index fcdb_stat(_self, st.issuer.value);
-  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw());
+ACTION dbonds::netsettle() {
+  PROFILE_ACTION("netsettle");
+  // ==========================================================================================
+  // || Pays out the net amounts of the netting session and closes it. Can be called by      ||
+  // ||   anybody, so that a session left open by its transaction does not lock the payouts. ||
+  // || Does nothing if no session is open, so desks may append it to every transaction.     ||
+  // ==========================================================================================
 
-  fcdb_stat.modify(fcdb_info, st.issuer, [&](auto& s) {
-    s.fc_state = state;
-  });
+  net_session_singleton session_table(_self, _self.value);
+  if(!session_table.exists())
+    return;
+  settle_net_session(session_table.get());
+  session_table.remove();
 }
 #endif
 
-void dbonds::ontransfer(name from, name to, asset quantity, const string& memo) {
+ACTION dbonds::migratefcdb(name emitent, dbond_id_class dbond_id) {
+  PROFILE_ACTION("migratefcdb");
   // ==========================================================================================
-  // || Processes transfers where _self is a recipient                                       ||
+  // || Rewrites one fc_dbond_stats row from the old layout (string ISIN and currency,       ||
+  // ||   int64 apr, int state and confirmation fields) into the fixed-width one.            ||
+  // || Can be called by dBonds or by dbond.emitent, RAM is billed to the caller.            ||
   // ==========================================================================================
-  if(to == _self) {
-    name token_contract = get_first_receiver();
-    name seller;
-    dbond_id_class memo_dbond_id;
-
-    // retire payment
-    if(utility::match_memo(memo, "retire ", memo_dbond_id)) {
-      // fail tx if dbond_id is empty
-      check(memo_dbond_id != symbol_code(), "undefined dbond id");
 
-      retire_fcdb(memo_dbond_id, extended_asset{quantity, token_contract});
-      return;
-    }
-    // somebody buys fcdb
-    if(utility::match_memo(memo, "buy ? from ?", memo_dbond_id, seller)) {
-      updfcdb(memo_dbond_id);
-      register_private_order_fcdb(memo_dbond_id, seller, from, extended_asset{quantity, token_contract}, false);
-      return;
-    }
+  bool by_emitent = has_auth(emitent);
+  if(!by_emitent)
+    require_auth(_self);
+
+  // old rows cannot be read through fc_dbond_index, so read the raw row
+  int32_t itr = internal_use_do_not_use::db_find_i64(_self.value, emitent.value, "fcdbond"_n.value, dbond_id.raw());
+  check(itr >= 0, "dbond not found in fc_dbond table");
+
+  uint32_t size = internal_use_do_not_use::db_get_i64(itr, nullptr, 0);
+  vector<char> buffer(size);
+  internal_use_do_not_use::db_get_i64(itr, buffer.data(), size);
+
+  check(is_fcdb_row_v0(buffer), "dbond row is not in the old layout");
+  fc_dbond_stats_v0 old;
+  datastream<const char*> ds(buffer.data(), buffer.size());
+  ds >> old;
+
+  internal_use_do_not_use::db_remove_i64(itr);
+
+  name payer = by_emitent ? emitent : _self;
+
+  // collateral info goes to the shared registry
+  fiat_bond collateral;
+  // old rows took any strings, the ones which do not conform are kept as hashes
+  collateral.ISIN                     = utility::isin_code_or_hash(old.ISIN);
+  collateral.name                     = old.collateral_name;
+  collateral.issuer                   = old.collateral_issuer;
+  collateral.currency                 = utility::currency_code_or_hash(old.currency);
+  collateral.maturity_time            = old.collateral_maturity_time;
+  collateral.bond_description_webpage = old.bond_description_webpage;
+
+  fiat_bonds registry(_self, _self.value);
+  if(registry.find(collateral.ISIN) == registry.end()) {
+    registry.emplace(payer, [&](auto& f) {
+      f.bond       = collateral;
+      f.ref_count  = 0;
+      f.registrant = payer;
+    });
   }
+  add_fiat_bond_ref(collateral.ISIN);
+
+  fc_dbond bond;
+  bond.dbond_id                               = old.dbond_id;
+  bond.emitent                                = old.emitent;
+  bond.quantity_to_issue                      = old.quantity_to_issue;
+  bond.maturity_time                          = old.maturity_time;
+  bond.retire_time                            = old.retire_time;
+  bond.payoff_price                           = old.payoff_price;
+  bond.fungible                               = old.fungible;
+  bond.additional_info                        = old.additional_info;
+  bond.collateral_isin                        = collateral.ISIN;
+  bond.verifier                               = old.verifier;
+  bond.counterparty                           = old.counterparty;
+  bond.liquidation_agent                      = old.liquidation_agent;
+  bond.escrow_contract_link                   = old.escrow_contract_link;
+  bond.holders_list                           = old.holders_list;
+
+  check(old.apr >= 0 && old.apr <= std::numeric_limits<uint16_t>::max(), "apr does not fit into the new layout");
+  check(old.fc_state >= int(utility::fcdb_state::First) && old.fc_state <= int(utility::fcdb_state::Last), "wrong fc_state in old row");
+  bond.apr = uint16_t(old.apr);
+  bond.accrual_basis = daycount::ACT_365 | daycount::SIMPLE;  // the only basis old rows were priced with
+
+  fc_dbond_index fcdb_stat(_self, emitent.value);
+  fcdb_stat.emplace(payer, [&](auto& s) {
+    s.dbond         = bond;
+    s.initial_time  = old.initial_time;
+    s.initial_price = old.initial_price;
+    s.current_price = old.current_price;
+    s.state_flags   = 0;
+    s.unit          = utility::pow(10, bond.quantity_to_issue.symbol.precision());
+    s.set_state(utility::fcdb_state(old.fc_state));
+    if(old.confirmed_by_counterparty == 1)
+      s.set_confirmed_by_counterparty();
+  });
+  set_state_index(dbond_id, emitent, utility::fcdb_state(old.fc_state));
 }
 
-//////////////////////////////////////////////////////////
+bool dbonds::is_fcdb_row_v0(const vector<char>& row) {
+  // ==========================================================================================
+  // || Walks field sizes of fc_dbond_stats_v0 without decoding, so that a row of another    ||
+  // ||   layout is told apart instead of overrunning the datastream.                        ||
+  // ==========================================================================================
+  size_t pos = 0;
+  auto fixed = [&](uint64_t n) {
+    if(n > row.size() - pos)
+      return false;
+    pos += n;
+    return true;
+  };
+  // varuint count followed by count items of item_size bytes
+  auto counted = [&](uint64_t item_size) {
+    uint64_t count = 0;
+    for(int shift = 0; ; shift += 7) {
+      if(pos >= row.size() || shift > 28)
+        return false;
+      uint8_t byte = row[pos++];
+      count |= uint64_t(byte & 0x7f) << shift;
+      if(!(byte & 0x80))
+        break;
+    }
+    return count <= row.size() && fixed(count * item_size);
+  };
+  return fixed(8 + 8 + 16 + 8 + 8 + 24 + 1)       // dbond_id .. fungible
+    && counted(1)                                   // additional_info
+    && counted(1) && counted(1) && counted(1)       // ISIN, collateral_name, collateral_issuer
+    && counted(1) && fixed(8) && counted(1)         // currency, collateral_maturity_time, webpage
+    && fixed(8 + 8 + 8) && counted(1)               // verifier .. liquidation_agent, escrow_contract_link
+    && fixed(8) && counted(8)                       // apr, holders_list
+    && fixed(8 + 24 + 24 + 4 + 4)                   // initial_time .. confirmed_by_counterparty
+    && pos == row.size();
+}
 
-void dbonds::sub_balance(name owner, asset value){
-  accounts from_acnts(_self, owner.value);
+ACTION dbonds::setshard(uint32_t index, uint32_t count) {
+  PROFILE_ACTION("setshard");
+  // ==========================================================================================
+  // || Makes this instance one of count shards, owning dbond ids which utility::shard_of()  ||
+  // ||   maps to index. Dbonds of other shards cannot be created here.                      ||
+  // || Can be set once, changing the slicing would orphan existing dbonds.                  ||
+  // ==========================================================================================
 
-  const auto& from = from_acnts.get(value.symbol.code().raw(), "no balance object found");
-  check(from.balance.amount >= value.amount, "overdrawn balance");
+  require_auth(_self);
+  check(count > 0 && index < count, "shard index must be less than shard count");
 
-  #ifdef DEBUG
-    name ram_payer = _self;
-  #else
-    name ram_payer = owner;
-  #endif
-  from_acnts.modify(from, ram_payer, [&](auto& a) {
-    a.balance -= value;
-  });
+  shard_config_singleton shard_table(_self, _self.value);
+  check(!shard_table.exists(), "shard is configured already");
+  shard_table.set(shard_config{index, count}, _self);
 }
 
-void dbonds::add_balance(name owner, asset value, name ram_payer){
-  accounts to_acnts(_self, owner.value);
-  auto to = to_acnts.find(value.symbol.code().raw());
-  if(to == to_acnts.end()) {
-    to_acnts.emplace(ram_payer, [&](auto& a){
-      a.balance = value;
-    });
-  } else {
-    to_acnts.modify(to, same_payer, [&](auto& a) {
-      a.balance += value;
+ACTION dbonds::regfiatbond(name payer, const fiat_bond& bond) {
+  PROFILE_ACTION("regfiatbond");
+  // ==========================================================================================
+  // || Registers collateral fiat bond info to be referenced by fc dbonds via ISIN.          ||
+  // || Registering the same info again is a no-op. Info can be changed only while no       ||
+  // ||   dbond references it, by the account which registered it or by dBonds.             ||
+  // ==========================================================================================
+
+  require_auth(payer);
+  check(bond.ISIN != 0, "ISIN must be set");
+  check(bond.currency.is_valid(), "invalid currency");
+
+  fiat_bonds registry(_self, _self.value);
+  auto existing = registry.find(bond.ISIN);
+
+  if(existing == registry.end()) {
+    registry.emplace(payer, [&](auto& f) {
+      f.bond       = bond;
+      f.ref_count  = 0;
+      f.registrant = payer;
     });
+    return;
   }
+  if(pack(existing->bond) == pack(bond))
+    return;
+
+  check(payer == existing->registrant || payer == _self, "fiat bond is registered by another account");
+  check(existing->ref_count == 0, "fiat bond is referenced by dbonds, change is not allowed");
+  registry.modify(existing, same_payer, [&](auto& f) {
+    f.bond = bond;
+  });
 }
 
-void dbonds::check_fcdb_sanity(const fc_dbond& bond) {
+ACTION dbonds::delfiatbond(uint64_t isin) {
+  PROFILE_ACTION("delfiatbond");
   // ==========================================================================================
-  // || Function checks that the dbond parameters make sence, fail the transaction if not    ||
+  // || Releases RAM of registered fiat bond which is not referenced by any dbond.           ||
+  // || Referenced ones are erased automatically when the last dbond releases them.          ||
+  // || Is called with auth of the account which registered it or of dBonds.                ||
   // ==========================================================================================
 
-  check(is_account(bond.verifier), "verifier account does not exist");
+  fiat_bonds registry(_self, _self.value);
+  const auto& fb = registry.get(isin, "fiat bond not found");
+  check(has_auth(fb.registrant) || has_auth(_self), "missing authority of the fiat bond registrant");
+  check(fb.ref_count == 0, "fiat bond is referenced by dbonds");
+  registry.erase(fb);
+}
 
-  check(bond.holders_list.size() < utility::max_holders_number, "there cannot be that many holders of the dbond");
+#ifndef NO_CC_DBONDS
+ACTION dbonds::initccdb(const cc_dbond& bond) {
+  PROFILE_ACTION("initccdb");
+  // ==========================================================================================
+  // || Creates or, while in CREATED state and without locked collateral, rewrites a         ||
+  // ||   crypto-collateralized dbond. Is called with auth of dbond.emitent.                 ||
+  // || Collateral goes to the pooled vault of its token, see lockccdb.                      ||
+  // ==========================================================================================
 
-  bool dbonds_in_holders = false;
-  bool emitent_in_holders = false;
-  for (auto acc : bond.holders_list){
-    check(is_account(acc), "one of dbond holders is not a valid account");
-    if(acc == bond.emitent)
-      emitent_in_holders = true;
+  require_auth(bond.emitent);
+  check_ccdb_sanity(bond);
+
+  stats statstable(_self, bond.dbond_id.raw());
+  auto dbond_stat = statstable.find(bond.dbond_id.raw());
+  if(dbond_stat == statstable.end()) {
+    create_token(bond.emitent, bond.quantity_to_issue);
+  }
+  else {
+    check(dbond_stat->issuer == bond.emitent, "dbond id is taken by another emitent");
+  }
+
+  fc_dbond_index fcdb_stat(_self, bond.emitent.value);
+  check(fcdb_stat.find(bond.dbond_id.raw()) == fcdb_stat.end(), "dbond id is taken by an fc dbond");
+#ifndef NO_BASKETS
+  baskets basket_table(_self, _self.value);
+  check(basket_table.find(bond.dbond_id.raw()) == basket_table.end(), "dbond id is taken by a basket");
+#endif
+
+  uint64_t vault_id = open_vault(bond.crypto_collateral.get_extended_symbol(), bond.emitent);
+
+  cc_dbond_index ccdb_stat(_self, bond.emitent.value);
+  auto ccdb_info = ccdb_stat.find(bond.dbond_id.raw());
+  if(ccdb_info == ccdb_stat.end()) {
+    ccdb_stat.emplace(bond.emitent, [&](auto& s) {
+      s.dbond             = bond;
+      s.initial_time      = time_point();
+      s.state_flags       = uint8_t(utility::fcdb_state::CREATED);
+      s.vault_id          = vault_id;
+      s.collateral_shares = 0;
+    });
+    return;
+  }
+  check(ccdb_info->state() == utility::fcdb_state::CREATED, "dbond exists and not in CREATED state, change is not allowed");
+  check(ccdb_info->collateral_shares == 0, "collateral is locked already, change is not allowed");
+  ccdb_stat.modify(ccdb_info, bond.emitent, [&](auto& s) {
+    s.dbond    = bond;
+    s.vault_id = vault_id;
+  });
+  statstable.modify(dbond_stat, same_payer, [&](auto& s) {
+    s.supply.symbol = bond.quantity_to_issue.symbol;
+    s.max_supply    = bond.quantity_to_issue;
+  });
+}
+
+ACTION dbonds::lockccdb(dbond_id_class dbond_id) {
+  PROFILE_ACTION("lockccdb");
+  // ==========================================================================================
+  // || Moves vault shares worth dbond.crypto_collateral from the emitent's claim under the  ||
+  // ||   dbond. The claim is topped up by a token transfer to dBonds with memo "deposit".   ||
+  // ==========================================================================================
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+  require_auth(st.issuer);
+
+  cc_dbond_index ccdb_stat(_self, st.issuer.value);
+  const auto& ccdb_info = ccdb_stat.get(dbond_id.raw(), "dbond not found in cc_dbond table");
+  check(ccdb_info.state() == utility::fcdb_state::CREATED, "dbond must be in CREATED state");
+  check(ccdb_info.collateral_shares == 0, "collateral is locked already");
+
+  vaults vault_table(_self, _self.value);
+  const auto& v = vault_table.get(ccdb_info.vault_id, "FATAL ERROR: vault not found");
+  // shares are rounded up, so that the dbond is never short of its collateral
+  uint64_t shares = v.total_shares == 0
+    ? ccdb_info.dbond.crypto_collateral.quantity.amount
+    : uint64_t(((uint128_t)ccdb_info.dbond.crypto_collateral.quantity.amount * v.total_shares + v.balance.quantity.amount - 1)
+        / v.balance.quantity.amount);
+
+  sub_claim(st.issuer, ccdb_info.vault_id, shares);
+  ccdb_stat.modify(ccdb_info, same_payer, [&](auto& s) {
+    s.collateral_shares = shares;
+  });
+  change_state<cc_engine>(dbond_id, utility::fcdb_state::AGREEMENT_SIGNED);
+  flush_events();
+}
+
+ACTION dbonds::issueccdb(dbond_id_class dbond_id) {
+  PROFILE_ACTION("issueccdb");
+  // ==========================================================================================
+  // || Issues the whole quantity_to_issue to the emitent once the collateral is locked.     ||
+  // ==========================================================================================
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+  require_auth(st.issuer);
+
+  cc_dbond_index ccdb_stat(_self, st.issuer.value);
+  const auto& ccdb_info = ccdb_stat.get(dbond_id.raw(), "dbond not found in cc_dbond table");
+  check(ccdb_info.state() == utility::fcdb_state::AGREEMENT_SIGNED, "collateral must be locked first");
+
+  issue_token(st.issuer, ccdb_info.dbond.quantity_to_issue, std::string{});
+  change_state<cc_engine>(dbond_id, utility::fcdb_state::CIRCULATING);
+  update_bond<cc_engine>(dbond_id);
+  flush_events();
+}
+
+ACTION dbonds::updccdb(dbond_id_class dbond_id) {
+  PROFILE_ACTION("updccdb");
+  // ==========================================================
+  // || Public action which updates price and state of cc    ||
+  // ||   dbond depending on time, see updfcdb.              ||
+  // ==========================================================
+
+  update_bond<cc_engine>(dbond_id);
+  flush_events();
+}
+
+ACTION dbonds::redeemccdb(name holder, dbond_id_class dbond_id) {
+  PROFILE_ACTION("redeemccdb");
+  // ==========================================================================================
+  // || After the emitent failed to buy the dbonds back by maturity, holder exchanges all    ||
+  // ||   its dbonds for the proportional part of the collateral. The part is credited to    ||
+  // ||   the holder's claim, tokens leave dBonds only on withdraw.                          ||
+  // ==========================================================================================
+
+  require_auth(holder);
+  update_bond<cc_engine>(dbond_id);
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+  check(holder != st.issuer, "emitent gets collateral back by releaseccdb");
+
+  cc_dbond_index ccdb_stat(_self, st.issuer.value);
+  const auto& ccdb_info = ccdb_stat.get(dbond_id.raw(), "dbond not found in cc_dbond table");
+  check(ccdb_info.state() == utility::fcdb_state::EXPIRED_TECH_DEFAULTED
+    || ccdb_info.state() == utility::fcdb_state::EXPIRED_DEFAULTED, "dbond is not defaulted");
+
+  asset balance = get_balance(_self, holder, dbond_id);
+  check(balance.amount > 0, "nothing to redeem");
+  uint64_t shares = uint64_t((uint128_t)ccdb_info.collateral_shares * balance.amount / st.supply.amount);
+
+  sub_balance(holder, balance, true);
+  statstable.modify(st, same_payer, [&](auto& s) {
+    s.supply -= balance;
+  });
+  ccdb_stat.modify(ccdb_info, same_payer, [&](auto& s) {
+    s.collateral_shares -= shares;
+  });
+  add_claim(holder, ccdb_info.vault_id, shares, holder);
+
+  log_event(utility::LOG_RETIRE, dbond_id, holder, name(), balance.amount, extended_asset());
+  notify(holder, utility::EVENT_RETIRE, dbond_id);
+  flush_events();
+}
+
+ACTION dbonds::releaseccdb(dbond_id_class dbond_id) {
+  PROFILE_ACTION("releaseccdb");
+  // ==========================================================================================
+  // || Returns the collateral left under the dbond to the emitent's claim, once the dbond   ||
+  // ||   is paid off (emitent holds all of it) or all other holders have redeemed.          ||
+  // ==========================================================================================
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+  require_auth(st.issuer);
+  update_bond<cc_engine>(dbond_id);
+
+  cc_dbond_index ccdb_stat(_self, st.issuer.value);
+  const auto& ccdb_info = ccdb_stat.get(dbond_id.raw(), "dbond not found in cc_dbond table");
+  check(utility::is_final_state(ccdb_info.state()) || ccdb_info.state() == utility::fcdb_state::EXPIRED_TECH_DEFAULTED,
+    "dbond is not expired");
+  check(get_balance(_self, st.issuer, dbond_id) == st.supply, "some holders have not redeemed yet");
+  check(ccdb_info.collateral_shares > 0, "nothing to release");
+
+  add_claim(st.issuer, ccdb_info.vault_id, ccdb_info.collateral_shares, st.issuer);
+  ccdb_stat.modify(ccdb_info, same_payer, [&](auto& s) {
+    s.collateral_shares = 0;
+  });
+  flush_events();
+}
+
+ACTION dbonds::withdraw(name owner, const extended_asset& quantity) {
+  PROFILE_ACTION("withdraw");
+  // ==========================================================================================
+  // || Pays out tokens of owner's claim. The only place where collateral leaves dBonds.     ||
+  // ==========================================================================================
+
+  require_auth(owner);
+  check(quantity.quantity.is_valid() && quantity.quantity.amount > 0, "must withdraw positive quantity");
+
+  vaults vault_table(_self, _self.value);
+  auto vault_index = vault_table.get_index<"bytoken"_n>();
+  const auto& v = vault_index.get(concat128(quantity.contract.value, quantity.quantity.symbol.raw()), "no vault for this token");
+
+  // shares are rounded up, so that the vault is never short of tokens
+  uint64_t shares = uint64_t(((uint128_t)quantity.quantity.amount * v.total_shares + v.balance.quantity.amount - 1)
+    / v.balance.quantity.amount);
+  sub_claim(owner, v.id, shares);
+  vault_table.modify(vault_table.get(v.id), same_payer, [&](auto& s) {
+    s.balance      -= quantity;
+    s.total_shares -= shares;
+  });
+
+  PROFILE_COUNT(inline_actions);
+  utility::send_transfer(quantity.contract, _self, owner, quantity.quantity, "withdraw");
+}
+#endif
+
+#ifndef NO_BASKETS
+ACTION dbonds::initbasket(name issuer, asset maximum_supply, const vector<asset>& components) {
+  PROFILE_ACTION("initbasket");
+  // ==========================================================================================
+  // || Creates basket token maximum_supply.symbol, one whole basket consists of the given   ||
+  // ||   amounts of circulating fc dbonds with the same payoff currency.                    ||
+  // || Is called with auth of the issuer, baskets are minted by anybody holding the dbonds. ||
+  // ==========================================================================================
+
+  require_auth(issuer);
+  check(!components.empty(), "basket has no dbonds");
+  check(components.size() <= utility::max_basket_components, "basket has too many dbonds");
+
+  basket new_basket;
+  new_basket.basket_id = maximum_supply.symbol.code();
+  for(const auto& q : components) {
+    check(q.is_valid() && q.amount > 0, "dbond amounts of the basket must be positive");
+    dbond_id_class dbond_id = q.symbol.code();
+    for(const auto& c : new_basket.components)
+      check(c.quantity.symbol.code() != dbond_id, "dbond is listed twice in the basket");
+
+    stats statstable(_self, dbond_id.raw());
+    const auto& st = statstable.get(dbond_id.raw(), "dbond of the basket not found");
+    check(q.symbol == st.supply.symbol, "symbol precision mismatch");
+
+    fc_dbond_index fcdb_stat(_self, st.issuer.value);
+    const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "only fc dbonds can be put into a basket");
+    check(fcdb_info.state() == utility::fcdb_state::CIRCULATING, "dbonds of the basket must be circulating");
+    if(new_basket.components.empty())
+      new_basket.currency = fcdb_info.current_price.get_extended_symbol();
+    check(fcdb_info.current_price.get_extended_symbol() == new_basket.currency,
+      "dbonds of the basket must have the same payoff currency");
+
+    new_basket.components.push_back({q, st.issuer});
+  }
+
+  create_token(issuer, maximum_supply);
+
+  baskets basket_table(_self, _self.value);
+  basket_table.emplace(issuer, [&](auto& b) {
+    b = new_basket;
+  });
+}
+
+ACTION dbonds::mintbasket(name owner, asset quantity) {
+  PROFILE_ACTION("mintbasket");
+  // ==========================================================================================
+  // || Moves the basket's dbonds for quantity from owner's balances to dBonds and issues    ||
+  // ||   quantity of the basket to owner. All dbonds of the basket must be circulating.     ||
+  // ==========================================================================================
+
+  require_auth(owner);
+  check(quantity.is_valid() && quantity.amount > 0, "must mint positive quantity");
+
+  baskets basket_table(_self, _self.value);
+  const auto& b = basket_table.get(quantity.symbol.code().raw(), "basket not found");
+
+  stats statstable(_self, quantity.symbol.code().raw());
+  const auto& st = statstable.get(quantity.symbol.code().raw(), "FATAL ERROR: basket token not found");
+  check(quantity.symbol == st.supply.symbol, "symbol precision mismatch");
+  check(quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+
+  basket_locks locks(_self, _self.value);
+  for(const auto& c : b.components) {
+    dbond_id_class dbond_id = c.quantity.symbol.code();
+    int64_t share = basket_share(c, quantity);
+
+    fc_dbond_index fcdb_stat(_self, c.emitent.value);
+    const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "dbond of the basket not found");
+    check(fcdb_info.state() == utility::fcdb_state::CIRCULATING, "dbonds of the basket must be circulating");
+    check(fcdb_info.dbond.fungible || share % fcdb_info.unit == 0,
+      "non-fungible dbond of the basket can be moved only in whole units");
+
+    asset moved{share, c.quantity.symbol};
+    sub_balance(owner, moved);
+    add_balance(_self, moved, _self);
+
+    auto lock = locks.find(dbond_id.raw());
+    if(lock == locks.end()) {
+      locks.emplace(_self, [&](auto& l) {
+        l.dbond_id = dbond_id;
+        l.locked   = share;
+        l.retired  = false;
+        l.payoff   = extended_asset{0, b.currency};
+      });
+    }
+    else {
+      locks.modify(lock, same_payer, [&](auto& l) {
+        l.locked += share;
+      });
+    }
+  }
+
+  statstable.modify(st, same_payer, [&](auto& s) {
+    s.supply += quantity;
+  });
+  add_balance(owner, quantity, owner);
+  notify(owner, utility::EVENT_TRANSFER, quantity.symbol.code());
+  flush_events();
+}
+
+ACTION dbonds::redeembasket(name owner, asset quantity) {
+  PROFILE_ACTION("redeembasket");
+  // ==========================================================================================
+  // || Burns quantity of the basket and gives owner its share of every dbond of the basket. ||
+  // || Retired dbonds are paid out from their payoff, dbonds which ended otherwise in a     ||
+  // ||   final state have nothing to give back.                                             ||
+  // ==========================================================================================
+
+  require_auth(owner);
+  check(quantity.is_valid() && quantity.amount > 0, "must redeem positive quantity");
+
+  baskets basket_table(_self, _self.value);
+  const auto& b = basket_table.get(quantity.symbol.code().raw(), "basket not found");
+
+  stats statstable(_self, quantity.symbol.code().raw());
+  const auto& st = statstable.get(quantity.symbol.code().raw(), "FATAL ERROR: basket token not found");
+  check(quantity.symbol == st.supply.symbol, "symbol precision mismatch");
+
+  sub_balance(owner, quantity);
+  statstable.modify(st, same_payer, [&](auto& s) {
+    s.supply -= quantity;
+  });
+
+  basket_locks locks(_self, _self.value);
+  for(const auto& c : b.components) {
+    dbond_id_class dbond_id = c.quantity.symbol.code();
+    int64_t share = basket_share(c, quantity);
+    const auto& lock = locks.get(dbond_id.raw(), "FATAL ERROR: basket lock not found");
+
+    extended_asset cash = lock.payoff;
+    cash.quantity.amount = 0;
+    if(lock.retired) {
+      cash.quantity.amount = int64_t((__int128)share * lock.payoff.quantity.amount / lock.locked);
+      if(cash.quantity.amount > 0) {
+        utility::memo_buffer memo;
+        memo << "basket redemption of dbond " << dbond_id;
+        PROFILE_COUNT(inline_actions);
+        utility::send_transfer(cash.contract, _self, owner, cash.quantity, memo.view());
+      }
+    }
+    else {
+      fc_dbond_index fcdb_stat(_self, c.emitent.value);
+      auto fcdb_info = fcdb_stat.find(dbond_id.raw());
+      if(fcdb_info != fcdb_stat.end() && !utility::is_final_state(fcdb_info->state())) {
+        check(may_hold_fcdb(fcdb_info->dbond, owner), "owner is not allowed to hold a dbond of the basket");
+        check(fcdb_info->dbond.fungible || share % fcdb_info->unit == 0,
+          "non-fungible dbond of the basket can be moved only in whole units");
+        asset moved{share, c.quantity.symbol};
+        sub_balance(_self, moved);
+        add_balance(owner, moved, owner);
+      }
+    }
+
+    if(lock.locked == share) {
+      locks.erase(lock);
+    }
+    else {
+      locks.modify(lock, same_payer, [&](auto& l) {
+        l.locked -= share;
+        l.payoff -= cash;
+      });
+    }
+  }
+}
+
+extended_asset dbonds::basketprice(dbond_id_class basket_id) {
+  PROFILE_ACTION("basketprice");
+  // ==========================================================================================
+  // || Read-only. Sums current_price of every dbond of the basket times its amount, in one  ||
+  // ||   pass over the basket. Retired dbonds count with their payoff, defaulted ones as 0. ||
+  // ==========================================================================================
+
+  baskets basket_table(_self, _self.value);
+  const auto& b = basket_table.get(basket_id.raw(), "basket not found");
+
+  basket_locks locks(_self, _self.value);
+  extended_asset total{0, b.currency};
+  for(const auto& c : b.components) {
+    dbond_id_class dbond_id = c.quantity.symbol.code();
+    auto lock = locks.find(dbond_id.raw());
+    if(lock != locks.end() && lock->retired) {
+      total.quantity.amount += int64_t((__int128)c.quantity.amount * lock->payoff.quantity.amount / lock->locked);
+      continue;
+    }
+    fc_dbond_index fcdb_stat(_self, c.emitent.value);
+    auto fcdb_info = fcdb_stat.find(dbond_id.raw());
+    if(fcdb_info == fcdb_stat.end() || utility::is_final_state(fcdb_info->state()))
+      continue;
+    // current_price is per whole dbond
+    total.quantity.amount += int64_t((__int128)c.quantity.amount * fcdb_info->current_price.quantity.amount / fcdb_info->unit);
+  }
+  return total;
+}
+#endif
+
+uint64_t dbonds::gc(dbond_id_class dbond_id, uint32_t max_rows) {
+  PROFILE_ACTION("gc");
+  // ==========================================================================================
+  // || Public action, erases zero balance rows of a dbond in final state.                   ||
+  // || Looks at no more than max_rows holders per call.                                     ||
+  // || Returns number of RAM bytes reclaimed.                                               ||
+  // ==========================================================================================
+
+  check(max_rows > 0, "max_rows must be positive");
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+
+  fc_dbond_index fcdb_stat(_self, st.issuer.value);
+  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "FATAL ERROR: dbond not found in fc_dbond table");
+  check(utility::is_final_state(fcdb_info.state()), "dbond is not in final state");
+
+  // zero balances are the last ones by balance
+  holdings index(_self, dbond_id.raw());
+  auto by_balance = index.get_index<"bybalance"_n>();
+  uint64_t reclaimed = 0;
+  uint32_t rows = 0;
+  for(auto it = by_balance.lower_bound(holding{name(), 0}.by_balance()); it != by_balance.end() && rows < max_rows; rows++) {
+    accounts acnts(_self, it->holder.value);
+    auto ac = acnts.find(dbond_id.raw());
+    if(ac != acnts.end()) {
+      reclaimed += pack_size(*ac) + utility::row_ram_overhead;
+      acnts.erase(ac);
+    }
+    reclaimed += pack_size(*it) + utility::row_ram_overhead;
+    it = by_balance.erase(it);
+  }
+  // zero balances of holders_list may predate the index, see syncholders
+  for(name holder : fcdb_info.dbond.holders_list) {
+    if(rows >= max_rows)
+      break;
+    accounts acnts(_self, holder.value);
+    auto ac = acnts.find(dbond_id.raw());
+    if(ac == acnts.end() || ac->balance.amount != 0)
+      continue;
+    reclaimed += pack_size(*ac) + utility::row_ram_overhead;
+    acnts.erase(ac);
+    rows++;
+  }
+  return reclaimed;
+}
+
+uint32_t dbonds::gcfinal(uint32_t max_rows) {
+  PROFILE_ACTION("gcfinal");
+  // ==========================================================================================
+  // || Erases all rows of dbonds in final state: orders (refunding payments), balances,     ||
+  // ||   dbond info and stats. Touches about max_rows rows per call, progress on a          ||
+  // ||   partially erased dbond is kept in gccursor singleton.                              ||
+  // || Returns number of rows erased.                                                       ||
+  // ==========================================================================================
+
+  require_auth(_self);
+  check(max_rows > 0, "max_rows must be positive");
+
+  gc_cursor_singleton cursor_table(_self, _self.value);
+  gc_cursor cursor = cursor_table.get_or_default();
+
+  uint32_t rows = 0;
+  while(rows < max_rows) {
+    if(cursor.dbond_id == dbond_id_class()) {
+      cursor.dbond_id = next_final_dbond();
+      cursor.stage    = GC_ORDERS;
+      if(cursor.dbond_id == dbond_id_class())
+        break;
+    }
+    rows += gc_final_dbond(cursor, max_rows - rows);
+  }
+
+  if(cursor.dbond_id != dbond_id_class())
+    cursor_table.set(cursor, _self);
+  else if(cursor_table.exists())
+    cursor_table.remove();
+
+  return rows;
+}
+
+ACTION dbonds::subscribe(name account, uint8_t events, bool batched) {
+  PROFILE_ACTION("subscribe");
+  // ==========================================================================================
+  // || Sets events account wants to be notified about, see utility::event_type.             ||
+  // || Batched mode is for indexers: instead of notification the event is listed in one     ||
+  // ||   logevents action sent at the end of the action. Zero events unsubscribe.           ||
+  // ==========================================================================================
+
+  require_auth(account);
+  check((events & ~utility::EVENT_ALL) == 0, "unknown event flags");
+
+  auto sub = subscribers.find(account.value);
+  if(events == 0) {
+    if(sub != subscribers.end())
+      subscribers.erase(sub);
+    return;
+  }
+  if(sub == subscribers.end()) {
+    subscribers.emplace(account, [&](auto& s) {
+      s.account = account;
+      s.events  = events;
+      s.batched = batched;
+    });
+  }
+  else {
+    subscribers.modify(sub, account, [&](auto& s) {
+      s.events  = events;
+      s.batched = batched;
+    });
+  }
+}
+
+ACTION dbonds::logevents(const vector<event_note>& events) {
+  PROFILE_ACTION("logevents");
+  // carries batched events to indexers, see notify()
+  require_auth(_self);
+}
+
+vector<price_point> dbonds::gethist(dbond_id_class dbond_id, time_point_sec from, time_point_sec to) {
+  PROFILE_ACTION("gethist");
+  // ==========================================================================================
+  // || Read-only action, returns price history points of dbond within [from, to].           ||
+  // || Decodes only chunks overlapping the range.                                           ||
+  // ==========================================================================================
+  vector<price_point> points;
+  price_history history(_self, dbond_id.raw());
+
+  // start from the chunk which contains "from"
+  auto chunk = history.upper_bound(from.sec_since_epoch());
+  if(chunk != history.begin())
+    --chunk;
+
+  for(; chunk != history.end() && chunk->first_time <= to; ++chunk) {
+    if(chunk->last_time < from)
+      continue;
+    uint32_t time = chunk->first_time.sec_since_epoch();
+    int64_t price = chunk->first_price;
+    size_t pos = 0;
+    for(uint8_t i = 0; i < chunk->samples; i++) {
+      if(i > 0) {
+        time  += utility::get_varint(chunk->deltas, pos);
+        price += utility::get_varint(chunk->deltas, pos);
+      }
+      if(time >= from.sec_since_epoch() && time <= to.sec_since_epoch())
+        points.push_back({time_point_sec(time), price});
+    }
+  }
+  return points;
+}
+
+vector<holder_balance> dbonds::getholders(dbond_id_class dbond_id, name lower_bound, uint32_t limit) {
+  PROFILE_ACTION("getholders");
+  // ==========================================================================================
+  // || Read-only action, returns holders of dbond from holders index in account name order, ||
+  // ||   starting at lower_bound. Next page starts after the last returned holder.          ||
+  // ==========================================================================================
+  check(limit > 0 && limit <= utility::max_holders_query, "limit must be in 1..1000");
+
+  vector<holder_balance> result;
+  holdings index(_self, dbond_id.raw());
+  for(auto it = index.lower_bound(lower_bound.value); it != index.end() && result.size() < limit; ++it)
+    result.push_back({it->holder, it->amount});
+  return result;
+}
+
+vector<holder_balance> dbonds::topholders(dbond_id_class dbond_id, uint32_t limit) {
+  PROFILE_ACTION("topholders");
+  // ==========================================================================================
+  // || Read-only action, returns up to limit holders of dbond with the largest balances.    ||
+  // ==========================================================================================
+  check(limit > 0 && limit <= utility::max_holders_query, "limit must be in 1..1000");
+
+  vector<holder_balance> result;
+  holdings index(_self, dbond_id.raw());
+  auto by_balance = index.get_index<"bybalance"_n>();
+  for(auto it = by_balance.begin(); it != by_balance.end() && result.size() < limit; ++it)
+    result.push_back({it->holder, it->amount});
+  return result;
+}
+
+ACTION dbonds::syncholders(dbond_id_class dbond_id, const vector<name>& holders) {
+  PROFILE_ACTION("syncholders");
+  // ==========================================================================================
+  // || Copies balances of the given accounts into holders index of dbond, for balance rows  ||
+  // ||   created before the index existed; accounts without a balance row are removed from  ||
+  // ||   it. Sweeps walk holders_list besides the index, so it is needed for proven holders ||
+  // ||   with such balances before the dbond is retired or reaches a final state.           ||
+  // ==========================================================================================
+  require_auth(_self);
+
+  for(name holder : holders) {
+    accounts acnts(_self, holder.value);
+    auto it = acnts.find(dbond_id.raw());
+    if(it == acnts.end())
+      erase_holding(holder, dbond_id);
+    else
+      update_holding(holder, it->balance, _self);
+  }
+}
+
+ACTION dbonds::setevlog(uint32_t capacity) {
+  PROFILE_ACTION("setevlog");
+  // ==========================================================================================
+  // || Sets number of slots of the event log ring buffer. Records in slots beyond the new   ||
+  // ||   capacity are erased, sequence numbering continues.                                 ||
+  // ==========================================================================================
+
+  require_auth(_self);
+  check(capacity > 0, "capacity must be positive");
+
+  event_log_singleton log_state_table(_self, _self.value);
+  auto log_state = log_state_table.get_or_default({0, utility::default_event_log_capacity});
+
+  event_log log(_self, _self.value);
+  for(auto it = log.lower_bound(capacity); it != log.end(); )
+    it = log.erase(it);
+
+  log_state.capacity = capacity;
+  log_state_table.set(log_state, _self);
+}
+
+#ifdef DEBUG
+/*
+ * Erase all given scopes
+ */
+ACTION dbonds::erase(vector<name> holders, dbond_id_class dbond_id) {
+  PROFILE_ACTION("erase");
+  require_auth(_self);
+  // stats:
+  erase_table<stats>(dbond_id.raw());
+  // accounts and their rows of holders indexes:
+  for(auto holder : holders) {
+    accounts acnts(_self, holder.value);
+    for(const auto& a : acnts)
+      erase_holding(holder, a.balance.symbol.code());
+    erase_table<accounts>(holder.value);
+    notify(holder, utility::EVENT_STATE, dbond_id);
+  }
+  // fc_dbond_index:
+  for(auto holder : holders) {
+    fc_dbond_index fcdb_stat(_self, holder.value);
+    for(const auto& fcdb_info : fcdb_stat)
+      release_fiat_bond_ref(fcdb_info.dbond.collateral_isin);
+    erase_table<fc_dbond_index>(holder.value);
+  }
+#ifndef NO_CC_DBONDS
+  // cc_dbond_index:
+  for(auto holder : holders)
+    erase_table<cc_dbond_index>(holder.value);
+#endif
+#ifndef NO_BASKETS
+  // baskets and basket_locks:
+  baskets basket_table(_self, _self.value);
+  auto b = basket_table.find(dbond_id.raw());
+  if(b != basket_table.end())
+    basket_table.erase(b);
+  basket_locks locks(_self, _self.value);
+  auto lock = locks.find(dbond_id.raw());
+  if(lock != locks.end())
+    locks.erase(lock);
+#endif
+#ifndef NO_PRIVATE_ORDERS
+  // fc_dbond_orders:
+  erase_table<fc_dbond_orders>(dbond_id.raw());
+#endif
+  // price_history:
+  erase_table<price_history>(dbond_id.raw());
+  // proven_holders and holder_roots:
+  erase_table<proven_holders>(dbond_id.raw());
+  holder_roots roots(_self, _self.value);
+  auto root = roots.find(dbond_id.raw());
+  if(root != roots.end())
+    roots.erase(root);
+  // holdings:
+  erase_table<holdings>(dbond_id.raw());
+  // fc_dbond_states:
+  erase_state_index(dbond_id);
+  flush_events();
+}
+
+ACTION dbonds::setstate(dbond_id_class dbond_id, int state) {
+  PROFILE_ACTION("setstate");
+  require_auth(_self);
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw());
+
+  fc_dbond_index fcdb_stat(_self, st.issuer.value);
+  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw());
+
+  fcdb_stat.modify(fcdb_info, st.issuer, [&](auto& s) {
+    s.set_state(utility::fcdb_state(state));
+  });
+  set_state_index(dbond_id, st.issuer, utility::fcdb_state(state));
+}
+
+/*
+ * Drop the holders index row, the balance is left as if it predated the index
+ */
+ACTION dbonds::unindex(dbond_id_class dbond_id, name holder) {
+  PROFILE_ACTION("unindex");
+  require_auth(_self);
+  erase_holding(holder, dbond_id);
+}
+#endif
+
+void dbonds::ontransfer(name from, name to, asset quantity, const string& memo) {
+  PROFILE_ACTION("ontransfer");
+  // ==========================================================================================
+  // || Processes transfers where _self is a recipient                                       ||
+  // ==========================================================================================
+  if(to == _self) {
+    name token_contract = get_first_receiver();
+    name seller;
+    dbond_id_class memo_dbond_id;
+
+    // retire payment
+    if(utility::match_memo(memo, "retire ", memo_dbond_id)) {
+      // fail tx if dbond_id is empty
+      check(memo_dbond_id != symbol_code(), "undefined dbond id");
+
+      retire_fcdb(memo_dbond_id, extended_asset{quantity, token_contract});
+    }
+#ifndef NO_CC_DBONDS
+    // collateral for cc dbonds, credited to the sender's claim
+    else if(memo == "deposit") {
+      vault_deposit(from, extended_asset{quantity, token_contract});
+    }
+#endif
+#ifndef NO_PRIVATE_ORDERS
+    // somebody buys fcdb
+    else if(utility::match_memo(memo, "buy ? from ?", memo_dbond_id, seller)) {
+      update_bond<fc_engine>(memo_dbond_id);
+      register_private_order_fcdb(memo_dbond_id, seller, from, extended_asset{quantity, token_contract}, false);
+    }
+#endif
+    flush_events();
+  }
+}
+
+//////////////////////////////////////////////////////////
+
+void dbonds::log_event(utility::log_type type, dbond_id_class dbond_id, name account, name counterparty,
+  int64_t amount, const extended_asset& value) {
+  // ==========================================================================================
+  // || Appends a record to the event log, overwriting the oldest one when the ring is full. ||
+  // ==========================================================================================
+  event_log_singleton log_state_table(_self, _self.value);
+  auto log_state = log_state_table.get_or_default({0, utility::default_event_log_capacity});
+
+  uint64_t seq = log_state.next_seq++;
+  uint64_t slot = seq % log_state.capacity;
+
+  auto fill = [&](auto& r) {
+    r.slot         = slot;
+    r.seq          = seq;
+    r.time         = time_point_sec(current_time_point());
+    r.type         = uint8_t(type);
+    r.dbond_id     = dbond_id;
+    r.account      = account;
+    r.counterparty = counterparty;
+    r.amount       = amount;
+    r.value        = value;
+  };
+
+  event_log log(_self, _self.value);
+  auto it = log.find(slot);
+  if(it == log.end())
+    log.emplace(_self, fill);
+  else
+    log.modify(it, same_payer, fill);
+
+  log_state_table.set(log_state, _self);
+}
+
+void dbonds::flush_events() {
+  // ==========================================================================================
+  // || Sends events batched by notify() in one logevents action. Every action which may     ||
+  // ||   notify calls it last.                                                              ||
+  // ==========================================================================================
+  if(batched_events.empty())
+    return;
+  PROFILE_COUNT(inline_actions);
+  SEND_INLINE_ACTION(*this, logevents, {{_self, "active"_n}}, {batched_events});
+  batched_events.clear();
+}
+
+void dbonds::notify(name account, utility::event_type event, dbond_id_class dbond_id) {
+  // ==========================================================================================
+  // || Notifies account only if it is subscribed to the event. Accounts subscribed in       ||
+  // ||   batched mode are listed in a single logevents action instead.                      ||
+  // ==========================================================================================
+  auto sub = subscribers.find(account.value);
+  if(sub == subscribers.end() || !(sub->events & event))
+    return;
+  if(sub->batched) {
+    batched_events.push_back({account, uint8_t(event), dbond_id});
+    return;
+  }
+  PROFILE_COUNT(notifications);
+  require_recipient(account);
+}
+
+uint64_t dbonds::sub_balance(name owner, asset value, bool erase_zero){
+  // ==========================================================================================
+  // || With erase_zero set, balance row which becomes zero is erased.                       ||
+  // || Returns number of RAM bytes released this way.                                       ||
+  // ==========================================================================================
+  accounts from_acnts(_self, owner.value);
+
+  const auto& from = from_acnts.get(value.symbol.code().raw(), "no balance object found");
+  check(from.balance.amount >= value.amount, "overdrawn balance");
+
+  if(erase_zero && from.balance.amount == value.amount) {
+    uint64_t reclaimed = pack_size(from) + utility::row_ram_overhead;
+    from_acnts.erase(from);
+    return reclaimed + erase_holding(owner, value.symbol.code());
+  }
+
+  #ifdef DEBUG
+    name ram_payer = _self;
+  #else
+    name ram_payer = owner;
+  #endif
+  from_acnts.modify(from, ram_payer, [&](auto& a) {
+    a.balance -= value;
+  });
+  update_holding(owner, from.balance, ram_payer);
+  return 0;
+}
+
+void dbonds::add_balance(name owner, asset value, name ram_payer){
+  accounts to_acnts(_self, owner.value);
+  add_balance(to_acnts, value, ram_payer);
+}
+
+void dbonds::add_balance(accounts& to_acnts, asset value, name ram_payer){
+  name owner(to_acnts.get_scope());
+  auto to = to_acnts.find(value.symbol.code().raw());
+  if(to == to_acnts.end()) {
+    to_acnts.emplace(ram_payer, [&](auto& a){
+      a.balance = value;
+    });
+    update_holding(owner, value, ram_payer);
+  } else {
+    to_acnts.modify(to, same_payer, [&](auto& a) {
+      a.balance += value;
+    });
+    update_holding(owner, to->balance, ram_payer);
+  }
+}
+
+uint64_t dbonds::update_holding(name holder, const asset& balance, name ram_payer) {
+  // ==========================================================================================
+  // || Sets the holders index row of holder to its balance. A new row is billed to the      ||
+  // ||   payer of the accounts row it mirrors.                                              ||
+  // || Returns number of RAM bytes used by a new row.                                       ||
+  // ==========================================================================================
+  holdings index(_self, balance.symbol.code().raw());
+  auto it = index.find(holder.value);
+  if(it == index.end()) {
+    const auto& h = index.emplace(ram_payer, [&](auto& h) {
+      h.holder = holder;
+      h.amount = balance.amount;
+    });
+    return pack_size(*h) + utility::row_ram_overhead;
+  }
+  if(it->amount != balance.amount) {
+    index.modify(it, same_payer, [&](auto& h) {
+      h.amount = balance.amount;
+    });
+  }
+  return 0;
+}
+
+uint64_t dbonds::erase_holding(name holder, symbol_code code) {
+  // returns number of RAM bytes reclaimed
+  holdings index(_self, code.raw());
+  auto it = index.find(holder.value);
+  if(it == index.end())
+    return 0;
+  uint64_t reclaimed = pack_size(*it) + utility::row_ram_overhead;
+  index.erase(it);
+  return reclaimed;
+}
+
+bool dbonds::may_hold_fcdb(const fc_dbond& bond, name account) {
+  // holders_list first, then accounts proven against the current holder root
+  if(fc_engine::may_hold(bond, account))
+    return true;
+
+  proven_holders proven(_self, bond.dbond_id.raw());
+  auto it = proven.find(account.value);
+  if(it == proven.end())
+    return false;
+
+  holder_roots roots(_self, _self.value);
+  auto root = roots.find(bond.dbond_id.raw());
+  return root != roots.end() && root->version == it->version;
+}
+
+void dbonds::check_fcdb_sanity(const fc_dbond& bond) {
+  // ==========================================================================================
+  // || Function checks that the dbond parameters make sence, fail the transaction if not    ||
+  // ==========================================================================================
+
+  check_fcdb_parties_sanity(bond);
+
+  fiat_bonds registry(_self, _self.value);
+  const auto& collateral = registry.get(bond.collateral_isin, "collateral fiat bond is not registered");
+  check_fcdb_terms_sanity(bond, collateral.bond);
+}
+
+void dbonds::check_fcdb_parties_sanity(const fc_dbond& bond) {
+  // accounts and holders part of check_fcdb_sanity(), shared by dbonds of a series
+
+  check(is_account(bond.verifier), "verifier account does not exist");
+
+  check(bond.holders_list.size() < utility::max_holders_number, "there cannot be that many holders of the dbond");
+
+  bool dbonds_in_holders = false;
+  bool emitent_in_holders = false;
+  for (auto acc : bond.holders_list){
+    check(is_account(acc), "one of dbond holders is not a valid account");
+    if(acc == bond.emitent)
+      emitent_in_holders = true;
     if(acc == _self)
       dbonds_in_holders = true;
   }
   check(emitent_in_holders, "you need to add your account to the holders_list");
   check(dbonds_in_holders, "you need to add thedbondsacc to the holders_list");
   check(bond.holders_list.size() >= 3, "at least 3 holders needed, forgot about counterparty?");
+}
+
+void dbonds::check_fcdb_terms_sanity(const fc_dbond& bond, const fiat_bond& collateral) {
+  // time terms part of check_fcdb_sanity(), checked for each dbond of a series
+
+  check(daycount::valid_basis(bond.accrual_basis), "unknown accrual_basis");
+  check(bond.apr <= daycount::max_apr, "apr is above 100%");
+  // no convention counts more years than ACT/360
+  check(bond.maturity_time <= current_time_point() + seconds(daycount::max_years * 360 * daycount::day_seconds),
+    "maturity_time is too far from the current time_point");
+
+  check(bond.fungible || bond.quantity_to_issue.amount % utility::pow(10, bond.quantity_to_issue.symbol.precision()) == 0,
+    "non-fungible dbond must be issued in whole units");
 
   check(bond.maturity_time >= current_time_point() + WEEK_uSECONDS, 
     "maturity_time is too close to the current time_point");
 
-  check(bond.maturity_time + WEEK_uSECONDS >= bond.collateral_bond.maturity_time,
+  check(bond.maturity_time + WEEK_uSECONDS >= collateral.maturity_time,
     "dbond maturity_time is too far from fiat bond maturity time");
 
-  check(bond.maturity_time <= bond.collateral_bond.maturity_time,
+  check(bond.maturity_time <= collateral.maturity_time,
     "dbond maturity_time must be not earlier than the fiat bond maturity time");
 
-  check(bond.collateral_bond.maturity_time + WEEK_uSECONDS <= bond.retire_time,
+  check(collateral.maturity_time + WEEK_uSECONDS <= bond.retire_time,
     "dbond retire_time must be at least a week later than bond maturity time");
 }
 
+bool dbonds::same_series(const fc_dbond& a, const fc_dbond& b) {
+  return a.emitent == b.emitent
+    && a.verifier == b.verifier
+    && a.counterparty == b.counterparty
+    && a.liquidation_agent == b.liquidation_agent
+    && a.holders_list == b.holders_list;
+}
+
 void dbonds::erase_dbond(dbond_id_class dbond_id) {
   // ==========================================================================================
   // || Function cleans all internal tables from dbond, but only if the whole supply         ||
@@ -561,33 +2023,245 @@ void dbonds::erase_dbond(dbond_id_class dbond_id) {
   auto dbonds_ac = dbonds_acnt.find(dbond_id.raw());
   if(dbonds_ac != dbonds_acnt.end())
     dbonds_acnt.erase(dbonds_ac);
+  erase_holding(_self, dbond_id);
 
   fc_dbond_index fcdb(_self, emitent.value);
-  fcdb.erase(fcdb.get(dbond_id.raw()));
+  const auto& fcdb_info = fcdb.get(dbond_id.raw());
+  release_fiat_bond_ref(fcdb_info.dbond.collateral_isin);
+  fcdb.erase(fcdb_info);
 
   statstable.erase(st);
+  erase_state_index(dbond_id);
+
+  price_history history(_self, dbond_id.raw());
+  for(auto it = history.begin(); it != history.end(); )
+    it = history.erase(it);
+
+  proven_holders proven(_self, dbond_id.raw());
+  for(auto it = proven.begin(); it != proven.end(); )
+    it = proven.erase(it);
+  holder_roots roots(_self, _self.value);
+  auto root = roots.find(dbond_id.raw());
+  if(root != roots.end())
+    roots.erase(root);
+}
+
+void dbonds::set_state_index(dbond_id_class dbond_id, name emitent, utility::fcdb_state state) {
+  fc_dbond_states states(_self, _self.value);
+  auto it = states.find(dbond_id.raw());
+  if(it == states.end()) {
+    states.emplace(_self, [&](auto& s) {
+      s.dbond_id = dbond_id;
+      s.emitent  = emitent;
+      s.state    = uint8_t(state);
+    });
+  }
+  else {
+    states.modify(it, same_payer, [&](auto& s) {
+      s.state = uint8_t(state);
+    });
+  }
+}
+
+bool dbonds::erase_state_index(dbond_id_class dbond_id) {
+  fc_dbond_states states(_self, _self.value);
+  auto it = states.find(dbond_id.raw());
+  if(it == states.end())
+    return false;
+  states.erase(it);
+  return true;
+}
+
+dbond_id_class dbonds::next_final_dbond() {
+  // final states are not adjacent, look up each of them
+  fc_dbond_states states(_self, _self.value);
+  auto by_state = states.get_index<"bystate"_n>();
+  for(auto state : {utility::fcdb_state::EXPIRED_PAID_OFF, utility::fcdb_state::EXPIRED_DEFAULTED}) {
+    auto it = by_state.lower_bound(state_key(state, dbond_id_class()));
+    if(it != by_state.end() && utility::fcdb_state(it->state) == state)
+      return it->dbond_id;
+  }
+  return dbond_id_class();
+}
+
+uint32_t dbonds::gc_final_dbond(gc_cursor& cursor, uint32_t max_rows) {
+  // ==========================================================================================
+  // || Erases rows of cursor.dbond_id stage by stage, returns number of rows touched.       ||
+  // || When the dbond is erased completely, the cursor is reset.                            ||
+  // ==========================================================================================
+  dbond_id_class dbond_id = cursor.dbond_id;
+  uint32_t rows = 0;
+
+  stats statstable(_self, dbond_id.raw());
+  const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
+
+  fc_dbond_index fcdb_stat(_self, st.issuer.value);
+  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw(), "FATAL ERROR: dbond not found in fc_dbond table");
+
+  if(cursor.stage == GC_ORDERS) {
+#ifndef NO_PRIVATE_ORDERS
+    // dbond tokens of the orders are at dBonds balance already, only payments go back
+    fc_dbond_orders fcdb_orders(_self, dbond_id.raw());
+    for(auto it = fcdb_orders.begin(); it != fcdb_orders.end() && rows < max_rows; rows++) {
+      if(it->recieved_payment.quantity.amount > 0) {
+        utility::memo_buffer memo;
+        memo << "refund for the order of dbond " << dbond_id;
+        PROFILE_COUNT(inline_actions);
+        utility::send_transfer(it->recieved_payment.contract, _self, it->buyer, it->recieved_payment.quantity, memo.view());
+      }
+      it = fcdb_orders.erase(it);
+    }
+    if(fcdb_orders.begin() == fcdb_orders.end())
+      cursor.stage = GC_ACCOUNTS;
+#else
+    cursor.stage = GC_ACCOUNTS;
+#endif
+  }
+
+  if(cursor.stage == GC_ACCOUNTS) {
+    // every balance row of the dbond, whoever holds it
+    holdings index(_self, dbond_id.raw());
+    for(auto it = index.begin(); it != index.end() && rows < max_rows; rows++) {
+      accounts acnts(_self, it->holder.value);
+      auto ac = acnts.find(dbond_id.raw());
+      if(ac != acnts.end())
+        acnts.erase(ac);
+      it = index.erase(it);
+    }
+    if(index.begin() == index.end()) {
+      // balances of holders_list may predate the index, see syncholders
+      bool left = false;
+      for(name holder : fcdb_info.dbond.holders_list) {
+        accounts acnts(_self, holder.value);
+        auto ac = acnts.find(dbond_id.raw());
+        if(ac == acnts.end())
+          continue;
+        if(rows >= max_rows) {
+          left = true;
+          break;
+        }
+        acnts.erase(ac);
+        rows++;
+      }
+      if(!left)
+        cursor.stage = GC_PROVEN;
+    }
+  }
+
+  if(cursor.stage == GC_PROVEN) {
+    proven_holders proven(_self, dbond_id.raw());
+    for(auto it = proven.begin(); it != proven.end() && rows < max_rows; rows++) {
+      // so may the balance of a proven holder
+      accounts acnts(_self, it->account.value);
+      auto ac = acnts.find(dbond_id.raw());
+      if(ac != acnts.end())
+        acnts.erase(ac);
+      it = proven.erase(it);
+    }
+    if(proven.begin() == proven.end())
+      cursor.stage = GC_HISTORY;
+  }
+
+  if(cursor.stage == GC_HISTORY) {
+    price_history history(_self, dbond_id.raw());
+    for(auto it = history.begin(); it != history.end() && rows < max_rows; rows++)
+      it = history.erase(it);
+    if(history.begin() == history.end())
+      cursor.stage = GC_INFO;
+  }
+
+  if(cursor.stage == GC_INFO && rows < max_rows) {
+    holder_roots roots(_self, _self.value);
+    auto root = roots.find(dbond_id.raw());
+    if(root != roots.end()) {
+      roots.erase(root);
+      rows++;
+    }
+    if(release_fiat_bond_ref(fcdb_info.dbond.collateral_isin))
+      rows++;
+    fcdb_stat.erase(fcdb_info);
+    statstable.erase(st);
+    rows += 2;
+    if(erase_state_index(dbond_id))
+      rows++;
+    cursor = gc_cursor{};
+  }
+
+  return rows;
+}
+
+void dbonds::add_fiat_bond_ref(uint64_t isin) {
+  fiat_bonds registry(_self, _self.value);
+  const auto& fb = registry.get(isin, "collateral fiat bond is not registered, call regfiatbond first");
+  registry.modify(fb, same_payer, [&](auto& f) {
+    f.ref_count++;
+  });
 }
 
-void dbonds::on_final_state(const fc_dbond_stats& fcdb_info) {
+bool dbonds::release_fiat_bond_ref(uint64_t isin) {
+  // erases the registry row together with the last reference, returns true if it did
+  fiat_bonds registry(_self, _self.value);
+  auto fb = registry.find(isin);
+  if(fb == registry.end())
+    return false;
+  if(fb->ref_count <= 1) {
+    registry.erase(fb);
+    return true;
+  }
+  registry.modify(fb, same_payer, [&](auto& f) {
+    f.ref_count--;
+  });
+  return false;
+}
+
+template<typename Engine>
+uint64_t dbonds::on_final_state(const typename Engine::stats_row& info) {
   // ==========================================================================================
   // || Things to do when dbond acquires the final state (check is_final_state() function)   ||
+  // || Returns number of RAM bytes reclaimed from holders.                                  ||
   // ==========================================================================================
   
-  dbond_id_class dbond_id = fcdb_info.dbond.dbond_id;
+  dbond_id_class dbond_id = info.dbond.dbond_id;
   // enforce explicit transfers from ALL holders to dBonds account
-  for(const auto& holder : fcdb_info.dbond.holders_list) {
-    accounts acnt(_self, holder.value);
-    asset balance = get_balance(_self, holder, dbond_id);
-    if(balance.amount != 0) {
-      sub_balance(holder, balance);
+  uint64_t reclaimed = 0;
+  if constexpr(Engine::restricted_holders) {
+    for_each_holder(info.dbond, [&](name holder) {
+      asset balance = get_balance(_self, holder, dbond_id);
+      if(holder == _self || balance.amount == 0)
+        return;
+      reclaimed += sub_balance(holder, balance, true);
       add_balance(_self, balance, _self);
-    }
+    });
   }
 
   // erase_dbond(dbond_id);
+  return reclaimed;
+}
+
+template<typename F>
+void dbonds::for_each_holder(const fc_dbond& bond, F&& f) {
+  // ==========================================================================================
+  // || Calls f for every account of the holders index of the dbond, then for every account  ||
+  // ||   of holders_list, whose balance may predate the index (see syncholders). An account  ||
+  // ||   may come twice, so f must tolerate a holder it has already processed.              ||
+  // ==========================================================================================
+  holdings index(_self, bond.dbond_id.raw());
+  for(auto it = index.begin(); it != index.end(); ) {
+    // the iterator moves on before f erases the row of the holder
+    name holder = it->holder;
+    ++it;
+    f(holder);
+  }
+  for(name holder : bond.holders_list)
+    f(holder);
 }
 
 void dbonds::change_fcdb_state(dbond_id_class dbond_id, utility::fcdb_state new_state) {
+  change_state<fc_engine>(dbond_id, new_state);
+}
+
+template<typename Engine>
+uint64_t dbonds::change_state(dbond_id_class dbond_id, utility::fcdb_state new_state) {
   check(new_state >= utility::fcdb_state::First
     && new_state <= utility::fcdb_state::Last, "wrong state to change to");
   
@@ -596,16 +2270,23 @@ void dbonds::change_fcdb_state(dbond_id_class dbond_id, utility::fcdb_state new_
   const auto& st = statstable.get(dbond_id.raw(), "dbond not found");
 
   // get dbond info
-  fc_dbond_index fcdb_stat(_self, st.issuer.value);
-  auto fcdb_info = fcdb_stat.find(dbond_id.raw());
+  typename Engine::index info_table(_self, st.issuer.value);
+  auto info = info_table.find(dbond_id.raw());
     
-  fcdb_stat.modify(fcdb_info, same_payer, [&](auto& stat) {
-    stat.fc_state = (int)new_state;
+  info_table.modify(info, same_payer, [&](auto& stat) {
+    stat.set_state(new_state);
   });
+  if constexpr(Engine::state_indexed)
+    set_state_index(dbond_id, st.issuer, new_state);
 
-  if(utility::is_final_state(new_state)) {
-    on_final_state(*fcdb_info);
-  }
+  log_event(utility::LOG_STATE, dbond_id, info->dbond.emitent, name(), int64_t(new_state), extended_asset());
+
+  notify(info->dbond.emitent, utility::EVENT_STATE, dbond_id);
+  notify(Engine::counterparty(info->dbond), utility::EVENT_STATE, dbond_id);
+
+  if(utility::is_final_state(new_state))
+    return on_final_state<Engine>(*info);
+  return 0;
 }
 
 void dbonds::retire_fcdb(dbond_id_class dbond_id, extended_asset total_quantity_sent) {
@@ -633,26 +2314,27 @@ void dbonds::retire_fcdb(dbond_id_class dbond_id, extended_asset total_quantity_
   check(total_quantity_sent.get_extended_symbol() == fcdb_info.dbond.payoff_price.get_extended_symbol(),
     "to retire dbond you need to send the pay-off asset");
 
+  notify(fcdb_info.dbond.emitent, utility::EVENT_RETIRE, dbond_id);
+
   if(has_auth(fcdb_info.dbond.emitent)) {
-    check(fcdb_info.fc_state == (int)utility::fcdb_state::CIRCULATING, 
+    check(fcdb_info.state() == utility::fcdb_state::CIRCULATING, 
       "emitent can retire dbond only if it is in CIRCULATING state");
 
     // force buy off. fails if not enough amount is sent
     extended_asset left_after_retire = total_quantity_sent;
-    for(name holder : fcdb_info.dbond.holders_list){
+    // holders from holders_list and proven ones
+    for_each_holder(fcdb_info.dbond, [&](name holder) {
       force_retire_from_holder(dbond_id, holder, left_after_retire);
-    }
+    });
+#ifndef NO_BASKETS
+    retire_basket_lock(dbond_id, fcdb_info, left_after_retire);
+#endif
     // transfer left_after_retire back to emitent if positive
     if(left_after_retire.quantity.amount != 0) {
-      action(
-        permission_level{_self, "active"_n},
-        left_after_retire.contract, "transfer"_n,
-        std::make_tuple(
-          _self,
-          fcdb_info.dbond.emitent,
-          left_after_retire.quantity,
-          string{"change for the retire of dbond "} + dbond_id.to_string())
-      ).send();
+      utility::memo_buffer memo;
+      memo << "change for the retire of dbond " << dbond_id;
+      PROFILE_COUNT(inline_actions);
+      utility::send_transfer(left_after_retire.contract, _self, fcdb_info.dbond.emitent, left_after_retire.quantity, memo.view());
     }
 
     // if succeed, all dbond supply is at emitent posession, dbond is at expired_paid_off state
@@ -660,17 +2342,14 @@ void dbonds::retire_fcdb(dbond_id_class dbond_id, extended_asset total_quantity_
   }
 
   else if(has_auth(fcdb_info.dbond.liquidation_agent)) {
-    check(fcdb_info.fc_state == (int)utility::fcdb_state::EXPIRED_TECH_DEFAULTED,
+    check(fcdb_info.state() == utility::fcdb_state::EXPIRED_TECH_DEFAULTED,
       "dbond.liquidation_agent can call retire only at EXPIRED_TECH_DEFAULTED state");
-    action(
-      permission_level{_self, "active"_n},
-      total_quantity_sent.contract, "transfer"_n,
-      std::make_tuple(
-        _self,
-        fcdb_info.dbond.counterparty,
-        total_quantity_sent.quantity,
-        string{"retire by liquidation_agent dbond "} + dbond_id.to_string())
-    ).send();
+    utility::memo_buffer memo;
+    memo << "retire by liquidation_agent dbond " << dbond_id;
+    PROFILE_COUNT(inline_actions);
+    utility::send_transfer(total_quantity_sent.contract, _self, fcdb_info.dbond.counterparty, total_quantity_sent.quantity, memo.view());
+    log_event(utility::LOG_RETIRE, dbond_id, fcdb_info.dbond.liquidation_agent, fcdb_info.dbond.counterparty,
+      st.supply.amount, total_quantity_sent);
     change_fcdb_state(dbond_id, utility::fcdb_state::EXPIRED_PAID_OFF);
   }
   else
@@ -692,24 +2371,27 @@ void dbonds::force_retire_from_holder(dbond_id_class dbond_id, name holder, exte
 
   // otherwise transfer dbond tokens holder->emitent and transfer appropriate payoff from dBonds
   asset dbonds_qtty = get_balance(_self, holder, dbond_id);
-  sub_balance(holder, dbonds_qtty);
-  add_balance(emitent, dbonds_qtty, _self);
+  if(dbonds_qtty.amount != 0) {
+    sub_balance(holder, dbonds_qtty, true);
+    add_balance(emitent, dbonds_qtty, _self);
+    notify(holder, utility::EVENT_RETIRE, dbond_id);
+  }
 
   fc_dbond_index fcdb(_self, emitent.value);
   const auto& fcdb_info = fcdb.get(dbond_id.raw());
   extended_asset price = fcdb_info.dbond.payoff_price;
-  int64_t payoff_amount = dbonds_qtty.amount * price.quantity.amount / utility::pow(10, price.quantity.symbol.precision());
+  // payoff_price is per whole dbond
+  int64_t payoff_amount = lifecycle::payoff(dbonds_qtty.amount, price.quantity.amount, fcdb_info.unit);
   extended_asset payoff{{payoff_amount, price.quantity.symbol}, price.contract};
-  if(payoff.quantity.amount != 0)
-    action(
-      permission_level{_self, "active"_n},
-      payoff.contract, "transfer"_n,
-      std::make_tuple(
-        _self,
-        holder,
-        payoff.quantity,
-        string{"payoff for the retire of dbond "} + dbond_id.to_string())
-    ).send();
+  if(payoff.quantity.amount != 0) {
+    utility::memo_buffer memo;
+    memo << "payoff for the retire of dbond " << dbond_id;
+    PROFILE_COUNT(inline_actions);
+    utility::send_transfer(payoff.contract, _self, holder, payoff.quantity, memo.view());
+  }
+
+  if(dbonds_qtty.amount != 0)
+    log_event(utility::LOG_RETIRE, dbond_id, holder, emitent, dbonds_qtty.amount, payoff);
 
   // extract the paid off amount from left_after_retire
   left_after_retire -= payoff;
@@ -717,6 +2399,145 @@ void dbonds::force_retire_from_holder(dbond_id_class dbond_id, name holder, exte
   check(payoff.quantity.amount >= 0, "not enough assets to pay off for dbond retirement");
 }
 
+#ifndef NO_CC_DBONDS
+void dbonds::check_ccdb_sanity(const cc_dbond& bond) {
+  // ==========================================================================================
+  // || Function checks that the cc dbond parameters make sence, fail the transaction if not ||
+  // ==========================================================================================
+
+  check(bond.quantity_to_issue.symbol.code() == bond.dbond_id, "quantity_to_issue symbol must be the dbond id");
+  check(bond.quantity_to_issue.is_valid() && bond.quantity_to_issue.amount > 0, "invalid quantity_to_issue");
+  check(is_account(bond.crypto_collateral.contract), "collateral token contract does not exist");
+  check(bond.crypto_collateral.quantity.is_valid() && bond.crypto_collateral.quantity.amount > 0,
+    "collateral must be positive");
+  check(bond.issue_price.quantity.is_valid() && bond.issue_price.quantity.amount > 0, "issue_price must be positive");
+  check(bond.maturity_time >= current_time_point() + WEEK_uSECONDS,
+    "maturity_time is too close to the current time_point");
+  check(bond.maturity_time + WEEK_uSECONDS <= bond.retire_time,
+    "dbond retire_time must be at least a week later than maturity time");
+}
+
+uint64_t dbonds::open_vault(const extended_symbol& token, name payer) {
+  // returns id of the vault for token, creating an empty one if there is none
+  vaults vault_table(_self, _self.value);
+  auto vault_index = vault_table.get_index<"bytoken"_n>();
+  auto existing = vault_index.find(concat128(token.get_contract().value, token.get_symbol().raw()));
+  if(existing != vault_index.end())
+    return existing->id;
+
+  uint64_t id = vault_table.available_primary_key();
+  vault_table.emplace(payer, [&](auto& v) {
+    v.id           = id;
+    v.balance      = extended_asset(0, token);
+    v.total_shares = 0;
+  });
+  return id;
+}
+
+void dbonds::vault_deposit(name owner, const extended_asset& value) {
+  // adds tokens received by dBonds to their vault and the new shares to owner's claim
+  vaults vault_table(_self, _self.value);
+  auto vault_index = vault_table.get_index<"bytoken"_n>();
+  const auto& v = vault_index.get(concat128(value.contract.value, value.quantity.symbol.raw()),
+    "no cc dbond is collateralized by this token");
+
+  uint64_t shares = v.total_shares == 0
+    ? value.quantity.amount
+    : uint64_t((uint128_t)value.quantity.amount * v.total_shares / v.balance.quantity.amount);
+  check(shares > 0, "deposit is too small");
+
+  vault_table.modify(vault_table.get(v.id), same_payer, [&](auto& s) {
+    s.balance      += value;
+    s.total_shares += shares;
+  });
+  // notification handler may bill RAM only to dBonds
+  add_claim(owner, v.id, shares, _self);
+}
+
+void dbonds::add_claim(name owner, uint64_t vault_id, uint64_t shares, name payer) {
+  if(shares == 0)
+    return;
+  claims claim_table(_self, owner.value);
+  auto existing = claim_table.find(vault_id);
+  if(existing == claim_table.end()) {
+    claim_table.emplace(payer, [&](auto& c) {
+      c.vault_id = vault_id;
+      c.shares   = shares;
+    });
+  }
+  else {
+    claim_table.modify(existing, same_payer, [&](auto& c) {
+      c.shares += shares;
+    });
+  }
+}
+
+void dbonds::sub_claim(name owner, uint64_t vault_id, uint64_t shares) {
+  claims claim_table(_self, owner.value);
+  const auto& existing = claim_table.get(vault_id, "no claim on this vault");
+  check(existing.shares >= shares, "claim is too small");
+  if(existing.shares == shares) {
+    claim_table.erase(existing);
+  }
+  else {
+    claim_table.modify(existing, same_payer, [&](auto& c) {
+      c.shares -= shares;
+    });
+  }
+}
+#endif
+
+#ifndef NO_BASKETS
+int64_t dbonds::basket_share(const basket_component& component, const asset& quantity) {
+  // amount of the component's dbond in quantity of the basket, component amount is per whole basket
+  __int128 amount = (__int128)quantity.amount * component.quantity.amount;
+  int64_t unit = utility::pow(10, quantity.symbol.precision());
+  check(amount % unit == 0, "basket quantity does not split into its dbonds exactly");
+  return int64_t(amount / unit);
+}
+
+void dbonds::check_basket_holder(const basket& b, name account) {
+  // basket holder must be allowed to hold every dbond of the basket still alive
+  for(const auto& c : b.components) {
+    fc_dbond_index fcdb_stat(_self, c.emitent.value);
+    auto fcdb_info = fcdb_stat.find(c.quantity.symbol.code().raw());
+    if(fcdb_info == fcdb_stat.end() || utility::is_final_state(fcdb_info->state()))
+      continue;
+    check(may_hold_fcdb(fcdb_info->dbond, account), "receiver is not allowed to hold a dbond of the basket");
+  }
+}
+
+void dbonds::retire_basket_lock(dbond_id_class dbond_id, const fc_dbond_stats& fcdb_info, extended_asset& left_after_retire) {
+  // ==========================================================================================
+  // || Buys off dbonds locked in baskets like force_retire_from_holder does for holders,    ||
+  // ||   the payoff stays at dBonds and is paid out by redeembasket.                        ||
+  // ==========================================================================================
+
+  basket_locks locks(_self, _self.value);
+  auto lock = locks.find(dbond_id.raw());
+  if(lock == locks.end())
+    return;
+
+  extended_asset price = fcdb_info.dbond.payoff_price;
+  // payoff_price is per whole dbond
+  int64_t payoff_amount = lifecycle::payoff(lock->locked, price.quantity.amount, fcdb_info.unit);
+  extended_asset payoff{{payoff_amount, price.quantity.symbol}, price.contract};
+  left_after_retire -= payoff;
+  check(left_after_retire.quantity.amount >= 0, "not enough assets to pay off for dbond retirement");
+
+  asset locked{lock->locked, fcdb_info.dbond.quantity_to_issue.symbol};
+  sub_balance(_self, locked);
+  add_balance(fcdb_info.dbond.emitent, locked, _self);
+
+  locks.modify(lock, same_payer, [&](auto& l) {
+    l.retired = true;
+    l.payoff  = payoff;
+  });
+  log_event(utility::LOG_RETIRE, dbond_id, _self, fcdb_info.dbond.emitent, locked.amount, payoff);
+}
+#endif
+
+#ifndef NO_PRIVATE_ORDERS
 void dbonds::register_private_order_fcdb(dbond_id_class dbond_id, name seller, name buyer, extended_asset recieved_asset, bool is_sell) {
   // ==========================================================================================
   // || Is called directly from parsing transfer as a case handling, checks paramenetrs for  ||
@@ -729,11 +2550,14 @@ void dbonds::register_private_order_fcdb(dbond_id_class dbond_id, name seller, n
   fc_dbond_index fcdb_stat(_self, st.issuer.value);
   const auto& fcdb_info = fcdb_stat.get(dbond_id.raw());
 
+  check(fcdb_info.state() == utility::fcdb_state::CIRCULATING, "private orders are allowed only for circulating dbonds");
+  check(fcdb_info.current_price.quantity.amount > 0, "dbond has no price, private orders are not allowed");
   check(seller == fcdb_info.dbond.counterparty || buyer == fcdb_info.dbond.counterparty, "dbond.counterparty must participate");
   check(seller != buyer, "you cannot do trade with yourself");
   check(!is_sell || recieved_asset.quantity.symbol.code() == dbond_id, "wrong asset sent to sell");
   check(is_sell || recieved_asset.get_extended_symbol() == fcdb_info.current_price.get_extended_symbol(), "wrong asset sent to buy");
 
+  PROFILE_COUNT(inline_actions);
   SEND_INLINE_ACTION(
     *this,
     listprivord,
@@ -754,66 +2578,119 @@ void dbonds::match_trade(dbond_id_class dbond_id, name seller, name buyer) {
   const auto st = statstable.get(dbond_id.raw(), "dbond not found");
 
   fc_dbond_index fcdb_stat(_self, st.issuer.value);
-  auto fcdb_info = fcdb_stat.get(dbond_id.raw());
-  
+  const auto& fcdb_info = fcdb_stat.get(dbond_id.raw());
 
   fc_dbond_orders fcdb_orders(_self, dbond_id.raw());
   auto fcdb_peers_index = fcdb_orders.get_index<"peers"_n>();
   const auto& fcdb_order = fcdb_peers_index.get(concat128(seller.value, buyer.value), "no order for this dbond_id, seller and buyer");
   
+  // order price is per whole dbond, computed by updfcdb with the dbond's accrual basis
+  __int128 unit = fcdb_info.unit;
+  __int128 price_amount = fcdb_order.price.quantity.amount;
+
   extended_asset order_quantity_value = fcdb_order.price;
-  order_quantity_value.quantity.amount = round(fcdb_order.price.quantity.amount* (1.0 * fcdb_order.recieved_quantity.amount /
-    utility::pow(10, fcdb_order.recieved_quantity.symbol.precision())));
+  order_quantity_value.quantity.amount = int64_t((2 * price_amount * fcdb_order.recieved_quantity.amount + unit) / (2 * unit));
 
   extended_asset trade_value = min(fcdb_order.recieved_payment, order_quantity_value);
 
-  extended_asset price_change = fcdb_order.recieved_payment - trade_value;
   asset trade_quantity = st.supply;
-  trade_quantity.amount = min((int64_t)round(1.0 * trade_value.quantity.amount / fcdb_order.price.quantity.amount * 
-      utility::pow(10, fcdb_order.price.quantity.symbol.precision())), fcdb_order.recieved_quantity.amount);
+  trade_quantity.amount = min(int64_t((2 * unit * trade_value.quantity.amount + price_amount) / (2 * price_amount)),
+    fcdb_order.recieved_quantity.amount);
+
+  if(!fcdb_info.dbond.fungible) {
+    // whole dbonds only, payment for the fraction goes back as change
+    trade_quantity.amount -= trade_quantity.amount % fcdb_info.unit;
+    trade_value.quantity.amount = min(trade_value.quantity.amount,
+      int64_t((2 * price_amount * trade_quantity.amount + unit) / (2 * unit)));
+  }
 
+  extended_asset price_change = fcdb_order.recieved_payment - trade_value;
   asset quantity_change = fcdb_order.recieved_quantity - trade_quantity;
-  string quantity_memo = string{"bought dbond "} + dbond_id.to_string();
-  string q_change_memo = string{"change for the trade of dbond "} + dbond_id.to_string();
-  if(trade_value.quantity.amount > 0){
-    action(
-      permission_level{_self, "active"_n},
-      trade_value.contract, "transfer"_n,
-      std::make_tuple(
-        _self,
-        seller,
-        trade_value.quantity,
-        string{"for selling of "} + dbond_id.to_string())
-    ).send();
-  }
-  if(price_change.quantity.amount > 0){
-    action(
-      permission_level{_self, "active"_n},
-      price_change.contract, "transfer"_n,
-      std::make_tuple(
-        _self,
-        buyer,
-        price_change.quantity,
-        string{"change for the trade of dbond "} + dbond_id.to_string())
-    ).send();
-  }
-  if(trade_quantity.amount > 0){
-    SEND_INLINE_ACTION(
-      *this,
-      transfer,
-      {{_self, "active"_n}},
-      {_self, buyer, trade_quantity, 
-      quantity_memo});
-  }
-  if(quantity_change.amount > 0){
-    SEND_INLINE_ACTION(
-      *this,
-      transfer,
-      {{_self, "active"_n}},
-      {_self, seller, quantity_change,
-       q_change_memo});
+
+  // inside a netting session of this transaction the payouts wait for netsettle
+  net_session_singleton session_table(_self, _self.value);
+  net_session session = session_table.get_or_default();
+  if(session.initiator != name() && session.trx_id == current_trx_id()) {
+    if(trade_value.quantity.amount > 0)
+      add_net_delta(session, seller, trade_value);
+    if(price_change.quantity.amount > 0)
+      add_net_delta(session, buyer, price_change);
+    if(trade_quantity.amount > 0)
+      add_net_delta(session, buyer, extended_asset{trade_quantity, _self});
+    if(quantity_change.amount > 0)
+      add_net_delta(session, seller, extended_asset{quantity_change, _self});
+    session.trades++;
+    session_table.set(session, _self);
+  }
+  else {
+    utility::memo_buffer change_memo;
+    change_memo << "change for the trade of dbond " << dbond_id;
+    if(trade_value.quantity.amount > 0){
+      utility::memo_buffer memo;
+      memo << "for selling of " << dbond_id;
+      PROFILE_COUNT(inline_actions);
+      utility::send_transfer(trade_value.contract, _self, seller, trade_value.quantity, memo.view());
+    }
+    if(price_change.quantity.amount > 0){
+      PROFILE_COUNT(inline_actions);
+      utility::send_transfer(price_change.contract, _self, buyer, price_change.quantity, change_memo.view());
+    }
+    if(trade_quantity.amount > 0){
+      utility::memo_buffer memo;
+      memo << "bought dbond " << dbond_id;
+      PROFILE_COUNT(inline_actions);
+      utility::send_transfer(_self, _self, buyer, trade_quantity, memo.view());
+    }
+    if(quantity_change.amount > 0){
+      PROFILE_COUNT(inline_actions);
+      utility::send_transfer(_self, _self, seller, quantity_change, change_memo.view());
+    }
   }
 
+  if(trade_quantity.amount > 0)
+    log_event(utility::LOG_TRADE, dbond_id, seller, buyer, trade_quantity.amount, trade_value);
+
   // now, delete order
   fcdb_orders.erase(fcdb_order);
 }
+
+void dbonds::add_net_delta(net_session& session, name account, const extended_asset& value) {
+  // adds value to what netsettle pays to account; RAM is on dBonds until the settlement
+  net_deltas deltas(_self, account.value);
+  auto asset_index = deltas.get_index<"byasset"_n>();
+  auto existing = asset_index.find(concat128(value.contract.value, value.quantity.symbol.raw()));
+  if(existing == asset_index.end()) {
+    if(deltas.begin() == deltas.end())
+      session.accounts.push_back(account);
+    deltas.emplace(_self, [&](auto& d) {
+      d.id     = deltas.available_primary_key();
+      d.amount = value;
+    });
+  }
+  else {
+    asset_index.modify(existing, same_payer, [&](auto& d) {
+      d.amount += value;
+    });
+  }
+}
+
+void dbonds::settle_net_session(const net_session& session) {
+  // pays every account of the session its net amounts, one transfer per asset
+  for(auto account : session.accounts) {
+    net_deltas deltas(_self, account.value);
+    for(auto it = deltas.begin(); it != deltas.end(); ) {
+      PROFILE_COUNT(inline_actions);
+      utility::send_transfer(it->amount.contract, _self, account, it->amount.quantity, "net settlement of dbond trades");
+      it = deltas.erase(it);
+    }
+  }
+}
+
+checksum256 dbonds::current_trx_id() {
+  // id of the running transaction is sha256 of its packed form
+  uint32_t size = transaction_size();
+  vector<char> buffer(size);
+  read_transaction(buffer.data(), size);
+  return sha256(buffer.data(), size);
+}
+#endif
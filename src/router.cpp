@@ -0,0 +1,25 @@
+#include <router.hpp>
+
+ACTION router::setshards(const vector<name>& shards) {
+  // ==========================================================================================
+  // || Sets accounts of the dbonds shards. Accounts may be replaced (e.g. on migration of   ||
+  // ||   a shard), but their number is fixed once set, since it defines the slicing.        ||
+  // ==========================================================================================
+
+  require_auth(_self);
+  check(!shards.empty(), "at least one shard needed");
+  for(auto shard : shards)
+    check(is_account(shard), "shard account does not exist");
+
+  shard_list_singleton list_table(_self, _self.value);
+  if(list_table.exists())
+    check(list_table.get().shards.size() == shards.size(), "number of shards cannot be changed");
+  list_table.set(shard_list{shards}, _self);
+}
+
+name router::getshard(symbol_code dbond_id) {
+  shard_list_singleton list_table(_self, _self.value);
+  check(list_table.exists(), "shards are not set");
+  const auto shards = list_table.get().shards;
+  return shards[utility::shard_of(dbond_id, shards.size())];
+}
@@ -0,0 +1,79 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+dbond_symbol="2,$bond_name"
+
+function init_test {
+	erase $emitent $counterparty $BUYER
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	confirmfcdb
+}
+
+function open_by {
+	action_return open '["'$1'", "'$dbond_symbol'", "'$2'"]' $2@active
+}
+
+function close_by {
+	action_return close '["'$1'", "'$dbond_symbol'"]' $1@active
+}
+
+function close_fails {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS close '["'$1'", "'$dbond_symbol'"]' -p $1@active
+}
+
+function gc {
+	action_return gc '["'$bond_name'", 10]' $BUYER@active
+}
+
+function gc_fails {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS gc '["'$bond_name'", 10]' -p $BUYER@active
+}
+
+function transfer_dbond {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS transfer '["'$1'", "'$2'", "'"$3"'", ""]' -p $1@active
+}
+
+function unindex {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS unindex '["'$bond_name'", "'$1'"]' -p $DBONDS@active
+}
+
+title "BALANCE ROWS TESTS"
+
+title "OPEN AND CLOSE"
+init_test
+used=`open_by $counterparty $counterparty`
+must_pass "open returns RAM used" [ "$used" -gt 0 ]
+used=`open_by $counterparty $counterparty`
+must_pass "open existing returns 0" [ "$used" = 0 ]
+reclaimed=`close_by $counterparty`
+must_pass "close returns RAM reclaimed" [ "$reclaimed" -gt 0 ]
+must_fail "close again" close_fails $counterparty
+must_pass "transfer to counterparty" transfer_dbond $emitent $counterparty "1.00 $bond_name"
+must_fail "close non-zero balance" close_fails $counterparty
+
+title "GC OF ZERO BALANCES"
+init_test
+must_pass "open" open_by $counterparty $counterparty
+must_fail "gc before final state" gc_fails
+setstate EXPIRED_PAID_OFF
+reclaimed=`gc`
+must_pass "gc returns RAM reclaimed" [ "$reclaimed" -gt 0 ]
+reclaimed=`gc`
+must_pass "nothing left to gc" [ "$reclaimed" = 0 ]
+
+title "GC OF ZERO BALANCES THAT PREDATE THE HOLDERS INDEX"
+init_test
+must_pass "open" open_by $counterparty $counterparty
+must_pass "drop counterparty from the index" unindex $counterparty
+setstate EXPIRED_PAID_OFF
+reclaimed=`gc`
+must_pass "gc returns RAM reclaimed" [ "$reclaimed" -gt 0 ]
+must_fail "balance row is erased" close_fails $counterparty
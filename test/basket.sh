@@ -0,0 +1,61 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+basket_name=DBASKT
+
+function init_test {
+	bond_name=$basket_name erase $emitent $counterparty $BUYER
+	erase $emitent $counterparty $BUYER
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	confirmfcdb
+}
+
+function initbasket {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS initbasket '["'$emitent'", "10.00 '$basket_name'", ["1.00 '$bond_name'"]]' -p $emitent@active
+}
+
+function mintbasket {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS mintbasket '["'$1'", "'"$2"'"]' -p $1@active
+}
+
+function redeembasket {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS redeembasket '["'$1'", "'"$2"'"]' -p $1@active
+}
+
+function transfers {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS transfers '["'$1'", [{"to": "'$2'", "quantity": "'"$3"'", "memo": ""}]]' -p $1@active
+}
+
+function balance {
+	sleep 3
+	cleos -u $API_URL get currency balance $DBONDS $1 $2
+}
+
+title "BASKET TESTS"
+
+title "MINT"
+init_test
+must_pass "init basket" initbasket
+must_fail "init basket twice" initbasket
+must_fail "fc dbond with the id of a basket" initfcdb "${bond_spec//$bond_name/$basket_name}"
+must_fail "mint more than dbonds held" mintbasket $counterparty "1.00 $basket_name"
+must_pass "mint basket" mintbasket $emitent "2.00 $basket_name"
+must_pass "dbonds are locked" [ "`balance $emitent $bond_name`" = "3.00 $bond_name" ]
+
+title "TRANSFERS OF BASKET TOKENS"
+must_pass "transfers basket to a holder of its dbonds" transfers $emitent $counterparty "1.00 $basket_name"
+must_fail "transfers basket to an account outside holders_list" transfers $emitent $BUYER "1.00 $basket_name"
+must_pass "transfers dbonds with the same action" transfers $emitent $counterparty "1.00 $bond_name"
+
+title "REDEEM"
+must_pass "redeem basket" redeembasket $counterparty "1.00 $basket_name"
+must_pass "dbonds are given back" [ "`balance $counterparty $bond_name`" = "2.00 $bond_name" ]
+must_fail "redeem more than held" redeembasket $counterparty "1.00 $basket_name"
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+bond_name=DBONDC
+collateral_quantity="10.00 $payoff_symbol"
+
+cc_bond_spec='{"dbond_id": "'$bond_name'",
+	"emitent": "'$emitent'",
+	"quantity_to_issue": "5.00 '$bond_name'",
+	"maturity_time": "'$dbond_maturity_time'",
+	"retire_time": "'$dbond_retire_time'",
+	"payoff_price": '$payoff_price',
+	"fungible": true,
+	"additional_info": "sdfsdfsdf",
+	"crypto_collateral": {"quantity": "'$collateral_quantity'", "contract": "'$payoff_contract'"},
+	"early_payoff_policy": 0,
+	"max_supply": "5.00 '$bond_name'",
+	"issue_price": '$payoff_price'}'
+
+function initccdb {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS initccdb "[$cc_bond_spec]" -p $emitent@active
+}
+
+function lockccdb {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS lockccdb '["'$bond_name'"]' -p $emitent@active
+}
+
+function issueccdb {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS issueccdb '["'$bond_name'"]' -p $emitent@active
+}
+
+function releaseccdb {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS releaseccdb '["'$bond_name'"]' -p $emitent@active
+}
+
+function deposit {
+	sleep 3
+	cleos -u $API_URL push action $payoff_contract transfer '["'$1'", "'$DBONDS'", "'"$2"'", "deposit"]' -p $1@active
+}
+
+function withdraw {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS withdraw '["'$1'", {"quantity": "'"$2"'", "contract": "'$payoff_contract'"}]' -p $1@active
+}
+
+title "CRYPTO-COLLATERALIZED DBOND TESTS"
+
+title "INIT"
+erase $emitent $counterparty $BUYER
+must_pass "init cc dbond" initccdb
+must_fail "fc dbond with the id of a cc dbond" initfcdb "${bond_spec//DBONDA/$bond_name}"
+
+title "LOCK COLLATERAL"
+must_fail "lock without a claim" lockccdb
+must_pass "deposit collateral" deposit $emitent "$collateral_quantity"
+must_pass "lock collateral" lockccdb
+must_fail "lock twice" lockccdb
+must_pass "issue" issueccdb
+must_fail "release before expiry" releaseccdb
+
+title "WITHDRAW"
+must_fail "withdraw locked collateral" withdraw $emitent "$collateral_quantity"
+must_pass "deposit more" deposit $emitent "1.00 $payoff_symbol"
+must_pass "withdraw the free part" withdraw $emitent "1.00 $payoff_symbol"
+must_fail "withdraw without a claim" withdraw $BUYER "1.00 $payoff_symbol"
@@ -11,7 +11,9 @@ dbond_maturity_time=`date --date=@"$now_plus_360" +%FT%T:000`
 maturity_time=`date --date=@"$now_plus_year" +%FT%T:000`
 dbond_retire_time=`date --date=@"$now_plus_375" +%FT%T:000`
 
-fiatbond='{"ISIN":"sdf", "name":"sdf", "currency":"sdf", "maturity_time": "'$maturity_time'", "bond_description_webpage":"sdf"}'
+# ISIN US0378331005 packed base-36, see utility::isin_code()
+isin=4051032581069391173
+fiatbond='{"ISIN":'$isin', "name":"sdf", "issuer":"sdf", "currency":"USD", "maturity_time": "'$maturity_time'", "bond_description_webpage":"sdf"}'
 
 bond_name=DBONDA
 emitent=$TESTACC
@@ -35,12 +37,13 @@ bond_spec='{"dbond_id": "'$bond_name'",
 	"payoff_price": '$payoff_price',
 	"fungible": true,
 	"additional_info": "sdfsdfsdf",
-	"collateral_bond": '$fiatbond',
+	"collateral_isin": '$isin',
 	"verifier": "'$verifier'",
 	"counterparty": "'$counterparty'",
 	"liquidation_agent": "'$liquidation_agent'",
 	"escrow_contract_link": "https://docs.google.com/document/d/1riKSakwS8p5EVSUA1PL-jCvcjev1kSFfCYR0suBeFkg",
 	"apr": 1000,
+	"accrual_basis": 0,
 	"holders_list": '$holders_list'}'
 
 bond_spec2='{"dbond_id": "'$bond_name'",
@@ -51,12 +54,13 @@ bond_spec2='{"dbond_id": "'$bond_name'",
 	"payoff_price": '$payoff_price',
 	"fungible": true,
 	"additional_info": "sdfsdfsdf",
-	"collateral_bond": '$fiatbond',
+	"collateral_isin": '$isin',
 	"verifier": "'$verifier'",
 	"counterparty": "'$counterparty'",
 	"liquidation_agent": "'$liquidation_agent'",
 	"escrow_contract_link": "https://docs.google.com/document/d/1riKSakwS8p5EVSUA1PL-jCvcjev1kSFfCYR0suBeFkg",
 	"apr": 1500,
+	"accrual_basis": 0,
 	"holders_list": '$holders_list'}'
 
 fcdb_states='CREATED = 0,
@@ -66,10 +70,17 @@ fcdb_states='CREATED = 0,
     EXPIRED_TECH_DEFAULTED = 4,
     EXPIRED_DEFAULTED = 5'
 
+function regfiatbond {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS regfiatbond "[\"$emitent\", $fiatbond]" -p $emitent@active
+}
+
 function initfcdb {
+	regfiatbond
 	sleep 3
 	spec=${1:-$bond_spec}
-	cleos -u $API_URL push action $DBONDS initfcdb "[$spec]" -p $emitent@active
+	collateral=${2:-$fiatbond}
+	cleos -u $API_URL push action $DBONDS initfcdb "[$spec, $collateral]" -p $emitent@active
 }
 
 function erase {
@@ -111,3 +122,15 @@ function get_extended_asset {
 	contract=`echo "$json" | jq -r .rows[0].$field_name.contract`
 	echo "$amount $symbol_code@$contract"
 }
+
+function setstate {
+	sleep 3
+	state=`echo "$fcdb_states" | grep -w "$1" | egrep -o '[0-9]+'`
+	cleos -u $API_URL push action $DBONDS setstate '["'$bond_name'", '$state']' -p $DBONDS@active
+}
+
+# pushes action of dBonds with given data and authorization, prints its return value
+function action_return {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS "$1" "$2" -p "$3" --json | jq -r '.processed.action_traces[0].return_value_data'
+}
@@ -53,3 +53,9 @@ must_fail "authdbond" authdbond_unauth
 must_pass "authdbond" authdbond
 must_pass "sell" transfer_to_sell $emitent $DBONDS "2.00 $bond_name"
 must_fail "buy more than available" transfer_to_buy $emitent $DBONDS "25.00 DUSD"
+
+title "SELL NOT CIRCULATING DBOND"
+init_test
+must_pass "authdbond" authdbond
+setstate EXPIRED_TECH_DEFAULTED
+must_fail "sell tech defaulted dbond" transfer_to_sell $emitent $DBONDS "2.00 $bond_name"
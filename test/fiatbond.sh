@@ -0,0 +1,50 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+fiatbond_changed='{"ISIN":'$isin', "name":"sdf", "issuer":"other issuer", "currency":"EUR", "maturity_time": "'$maturity_time'", "bond_description_webpage":"sdf"}'
+
+function regfiatbond_by {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS regfiatbond "[\"$1\", ${2:-$fiatbond}]" -p $1@active
+}
+
+function delfiatbond_by {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS delfiatbond "[$isin]" -p $1@active
+}
+
+function get_registrant {
+	cleos -u $API_URL get table $DBONDS $DBONDS fiatbonds -L $isin -U $isin | jq -r .rows[0].registrant
+}
+
+title "FIAT BONDS REGISTRY TESTS"
+
+title "REGISTRANT CHANGES AND DELETES"
+erase
+delfiatbond_by $DBONDS
+must_pass "register" regfiatbond_by $emitent
+must_pass "check registrant" [ "`get_registrant`" = "$emitent" ]
+must_pass "register same info again" regfiatbond_by $BUYER
+must_fail "change by another account" regfiatbond_by $BUYER "$fiatbond_changed"
+must_pass "check registrant kept" [ "`get_registrant`" = "$emitent" ]
+must_pass "change by registrant" regfiatbond_by $emitent "$fiatbond_changed"
+must_fail "delete by another account" delfiatbond_by $BUYER
+must_pass "delete by registrant" delfiatbond_by $emitent
+
+title "DBONDS CHANGES AND DELETES"
+must_pass "register" regfiatbond_by $BUYER
+must_pass "change by dBonds" regfiatbond_by $DBONDS "$fiatbond_changed"
+must_pass "check registrant kept" [ "`get_registrant`" = "$BUYER" ]
+must_pass "delete by dBonds" delfiatbond_by $DBONDS
+
+title "INITFCDB CHECKS EXPECTED COLLATERAL"
+erase
+must_pass "register" regfiatbond_by $emitent
+must_fail "initfcdb with other collateral" initfcdb "$bond_spec" "$fiatbond_changed"
+must_pass "initfcdb" initfcdb
+must_fail "change referenced" regfiatbond_by $emitent "$fiatbond_changed"
+must_fail "delete referenced" delfiatbond_by $emitent
+erase
+must_pass "released row is erased" [ "`get_registrant`" = "null" ]
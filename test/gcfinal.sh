@@ -0,0 +1,64 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+function init_test {
+	erase $emitent $counterparty
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	confirmfcdb
+}
+
+function gcfinal {
+	action_return gcfinal '['$1']' $DBONDS@active
+}
+
+function gcfinal_unauth {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS gcfinal '[10]' -p $BUYER@active
+}
+
+function get_state_row {
+	cleos -u $API_URL get table $DBONDS $DBONDS fcdbstates | jq -r '.rows[] | select(.dbond_id == "'$bond_name'") | .state'
+}
+
+function transfer_dbond {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS transfer '["'$1'", "'$2'", "'"$3"'", ""]' -p $1@active
+}
+
+function unindex {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS unindex '["'$bond_name'", "'$1'"]' -p $DBONDS@active
+}
+
+# prints balance of the holder, empty if there is no row
+function get_balance_row {
+	cleos -u $API_URL get table $DBONDS $1 accounts | jq -r '.rows[] | select(.balance | endswith(" '$bond_name'")) | .balance'
+}
+
+title "GCFINAL TESTS"
+
+title "ERASES DBOND IN FINAL STATE BY PARTS"
+init_test
+must_fail "not by dBonds" gcfinal_unauth
+setstate EXPIRED_PAID_OFF
+rows=`gcfinal 1`
+must_pass "one row per call" [ "$rows" = 1 ]
+must_pass "dbond is still there" [ -n "`get_state_row`" ]
+rows=`gcfinal 1000`
+must_pass "the rest erased" [ "$rows" -gt 0 ]
+must_pass "dbond is erased" [ -z "`get_state_row`" ]
+rows=`gcfinal 1000`
+must_pass "nothing left" [ "$rows" = 0 ]
+
+title "ERASES BALANCES THAT PREDATE THE HOLDERS INDEX"
+init_test
+must_pass "transfer to counterparty" transfer_dbond $emitent $counterparty "1.00 $bond_name"
+must_pass "drop counterparty from the index" unindex $counterparty
+setstate EXPIRED_PAID_OFF
+rows=`gcfinal 1000`
+must_pass "dbond erased" [ -z "`get_state_row`" ]
+must_pass "balance of counterparty erased" [ -z "`get_balance_row $counterparty`" ]
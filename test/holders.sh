@@ -0,0 +1,64 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+function init_test {
+	erase $emitent $counterparty $BUYER
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	confirmfcdb
+}
+
+# prints holder names returned by getholders, one per line
+function getholders {
+	action_return getholders '["'$bond_name'", "", '${1:-10}']' $BUYER@active | jq -r '.[].holder'
+}
+
+function getholders_fails {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS getholders '["'$bond_name'", "", '$1']' -p $BUYER@active
+}
+
+function topholder {
+	action_return topholders '["'$bond_name'", 1]' $BUYER@active | jq -r '.[0].holder'
+}
+
+function syncholders {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS syncholders '["'$bond_name'", ["'$counterparty'", "'$BUYER'"]]' -p $1@active
+}
+
+function transfer_dbond {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS transfer '["'$1'", "'$2'", "'"$3"'", ""]' -p $1@active
+}
+
+function retire {
+	sleep 3
+	cleos -u $API_URL push action $payoff_contract transfer '["'$emitent'", "'$DBONDS'", "'"$1"'", "retire '$bond_name'"]' -p $emitent@active
+}
+
+title "HOLDERS INDEX TESTS"
+
+title "GETHOLDERS AND TOPHOLDERS"
+init_test
+must_pass "transfer to counterparty" transfer_dbond $emitent $counterparty "1.00 $bond_name"
+holders=`getholders`
+must_pass "emitent is listed" grep -qx $emitent <<< "$holders"
+must_pass "counterparty is listed" grep -qx $counterparty <<< "$holders"
+must_pass "two holders" [ `wc -l <<< "$holders"` = 2 ]
+must_pass "one holder per page of one" [ `getholders 1 | wc -l` = 1 ]
+must_fail "zero limit" getholders_fails 0
+must_fail "limit above maximum" getholders_fails 1001
+must_pass "emitent holds the most" [ "`topholder`" = $emitent ]
+
+title "SYNCHOLDERS"
+must_fail "not by dBonds" syncholders $emitent
+must_pass "by dBonds" syncholders $DBONDS
+must_pass "account without balance is not added" [ `getholders | wc -l` = 2 ]
+
+title "RETIRE SWEEPS ALL HOLDERS"
+must_pass "retire" retire "20.00 $payoff_symbol"
+must_pass "only dBonds holds dbond after retire" [ "`getholders`" = $DBONDS ]
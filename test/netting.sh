@@ -0,0 +1,75 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+# a failed transaction must fail push_trx, not only the jq at its end
+set -o pipefail
+
+function authdbond {
+	sleep 3
+	cleos -u $API_URL push action $BANK_ACC authdbond '["'$DBONDS'", "'$bond_name'"]' -p $ADMIN_ACC@active
+}
+
+function init_test {
+	erase
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	authdbond
+}
+
+function netbegin_action {
+	echo '{"account": "'$DBONDS'", "name": "netbegin", "authorization": [{"actor": "'$emitent'", "permission": "active"}],
+		"data": {"initiator": "'$emitent'"}}'
+}
+
+function netsettle_action {
+	echo '{"account": "'$DBONDS'", "name": "netsettle", "authorization": [{"actor": "'$emitent'", "permission": "active"}],
+		"data": {}}'
+}
+
+function sell_action {
+	echo '{"account": "'$DBONDS'", "name": "transfer", "authorization": [{"actor": "'$emitent'", "permission": "active"}],
+		"data": {"from": "'$emitent'", "to": "'$DBONDS'", "quantity": "'"$1"'", "memo": "sell '$bond_name' to '$counterparty'"}}'
+}
+
+function buy_action {
+	echo '{"account": "'$payoff_contract'", "name": "transfer", "authorization": [{"actor": "'$emitent'", "permission": "active"}],
+		"data": {"from": "'$emitent'", "to": "'$DBONDS'", "quantity": "'"$1"'", "memo": "buy '$bond_name' from '$counterparty'"}}'
+}
+
+# pushes the given actions in one transaction and prints memos of all transfers in its trace
+function push_trx {
+	sleep 3
+	actions=$(IFS=,; echo "$*")
+	cleos -u $API_URL push transaction '{"actions": ['"$actions"']}' --json \
+		| jq -r '.processed.action_traces[] | select(.act.name == "transfer") | .act.data.memo'
+}
+
+function net_session {
+	sleep 3
+	cleos -u $API_URL get table $DBONDS $DBONDS netsession | jq -r '.rows[0].initiator // "null"'
+}
+
+title "NETTING TESTS"
+
+title "OFFSETTING TRADES IN ONE TRANSACTION"
+init_test
+memos=`push_trx "$(netbegin_action)" "$(sell_action "2.00 $bond_name")" "$(buy_action "17.00 $payoff_symbol")" "$(netsettle_action)"`
+must_pass "trades are settled by netsettle" grep -q "^net settlement of dbond trades$" <<< "$memos"
+must_fail "no direct payout of the sale" grep -q "^for selling of $bond_name$" <<< "$memos"
+must_fail "no direct delivery of dbonds" grep -q "^bought dbond $bond_name$" <<< "$memos"
+must_pass "session is closed" [ "`net_session`" = "null" ]
+
+title "NETSETTLE WITHOUT SESSION"
+must_pass "netsettle does nothing" push_trx "$(netsettle_action)"
+
+title "SESSION LEFT OPEN BY ITS TRANSACTION"
+init_test
+must_pass "netbegin without netsettle" push_trx "$(netbegin_action)" "$(sell_action "2.00 $bond_name")"
+must_pass "session stays open" [ "`net_session`" = "$emitent" ]
+must_fail "second netbegin in one transaction" push_trx "$(netbegin_action)" "$(netbegin_action)"
+must_pass "next netbegin settles the stale session" push_trx "$(netbegin_action)" "$(netsettle_action)"
+must_pass "session is closed" [ "`net_session`" = "null" ]
+must_pass "trades outside the session pay out directly" push_trx "$(buy_action "17.00 $payoff_symbol")"
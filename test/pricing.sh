@@ -0,0 +1,41 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+# collateral and dbond maturing in 29 years, on their own ISIN
+now_plus_29y=$((now+24*3600*365*29))
+now_plus_29y_15d=$((now_plus_29y+24*3600*15))
+long_maturity=`date --date=@"$now_plus_29y" +%FT%T:000`
+long_retire=`date --date=@"$now_plus_29y_15d" +%FT%T:000`
+fiatbond=`jq -c '.ISIN += 1 | .maturity_time = "'$long_maturity'"' <<< "$fiatbond"`
+long_spec=`jq -c '.collateral_isin += 1 | .maturity_time = "'$long_maturity'" | .retire_time = "'$long_retire'"' <<< "$bond_spec"`
+
+# ACT/365 compounded annually
+function spec_with {
+	jq -c '.apr = '$1' | .accrual_basis = 4' <<< "${2:-$long_spec}"
+}
+
+title "PRICING TESTS"
+
+title "HIGH APR, LONG HORIZON"
+erase
+must_pass "initfcdb at 100% for 29 years" initfcdb "`spec_with 10000`"
+must_pass "verifyfcdb" verifyfcdb
+must_pass "issuefcdb" issuefcdb
+current_price=`get_extended_asset current_price`
+must_pass "price is the smallest unit" [ "$current_price" = "0.01 DUSD@thedeposbank" ]
+
+title "APR ABOVE 100%"
+erase
+must_pass "initfcdb" initfcdb "`spec_with 10001`"
+must_fail "verifyfcdb" verifyfcdb
+
+title "HORIZON ABOVE 30 YEARS"
+now_plus_31y=$((now+24*3600*366*31))
+now_plus_31y_15d=$((now_plus_31y+24*3600*15))
+fiatbond=`jq -c '.ISIN += 1 | .maturity_time = "'$(date --date=@"$now_plus_31y" +%FT%T:000)'"' <<< "$fiatbond"`
+far_spec=`jq -c '.collateral_isin += 2 | .maturity_time = "'$(date --date=@"$now_plus_31y" +%FT%T:000)'" | .retire_time = "'$(date --date=@"$now_plus_31y_15d" +%FT%T:000)'"' <<< "$bond_spec"`
+erase
+must_pass "initfcdb" initfcdb "`spec_with 1000 "$far_spec"`"
+must_fail "verifyfcdb" verifyfcdb
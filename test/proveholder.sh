@@ -0,0 +1,67 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+function init_test {
+	erase $emitent $counterparty $BUYER
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	confirmfcdb
+}
+
+# hex sha256 of the account name value packed little-endian, leaf of the allowlist tree
+function leaf {
+	python3 -c '
+import hashlib, struct, sys
+chars = ".12345abcdefghijklmnopqrstuvwxyz"
+value = 0
+for i, c in enumerate(sys.argv[1][:13]):
+	v = chars.index(c)
+	value |= (v & 0x1f) << (64 - 5 * (i + 1)) if i < 12 else v & 0x0f
+print(hashlib.sha256(struct.pack("<Q", value)).hexdigest())' $1
+}
+
+# hex sha256 of two node hashes, the smaller one first
+function node {
+	python3 -c '
+import hashlib, sys
+a, b = sorted(bytes.fromhex(h) for h in sys.argv[1:3])
+print(hashlib.sha256(a + b).hexdigest())' $1 $2
+}
+
+function setholdroot {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS setholdroot '["'$bond_name'", "'$1'"]' -p $verifier@active
+}
+
+function proveholder {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS proveholder '["'$1'", "'$bond_name'", ['"$2"']]' -p $1@active
+}
+
+function transfer_dbond {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS transfer '["'$1'", "'$2'", "'"$3"'", ""]' -p $1@active
+}
+
+buyer_leaf=`leaf $BUYER`
+other_leaf=`leaf $ADMIN_ACC`
+root=`node $buyer_leaf $other_leaf`
+
+title "HOLDER ALLOWLIST TESTS"
+
+title "PROOF OF HOLDER"
+init_test
+must_fail "transfer to account outside holders_list" transfer_dbond $emitent $BUYER "1.00 $bond_name"
+must_fail "prove without allowlist" proveholder $BUYER '"'$other_leaf'"'
+must_fail "allowlist set by emitent" cleos -u $API_URL push action $DBONDS setholdroot '["'$bond_name'", "'$root'"]' -p $emitent@active
+must_pass "allowlist set by verifier" setholdroot $root
+must_fail "wrong proof" proveholder $BUYER '"'$buyer_leaf'"'
+must_pass "right proof" proveholder $BUYER '"'$other_leaf'"'
+must_pass "transfer to proven holder" transfer_dbond $emitent $BUYER "1.00 $bond_name"
+
+title "NEW ROOT INVALIDATES PROOFS"
+must_pass "new allowlist" setholdroot $other_leaf
+must_fail "transfer with outdated proof" transfer_dbond $emitent $BUYER "1.00 $bond_name"
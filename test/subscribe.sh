@@ -0,0 +1,47 @@
+#!/bin/bash
+
+. ../env.sh
+. ./common_fc.sh
+
+function init_test {
+	erase $emitent $counterparty $BUYER
+	initfcdb
+	verifyfcdb
+	issuefcdb
+	confirmfcdb
+}
+
+function subscribe {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS subscribe '["'$1'", '$2', '$3']' -p $1@active
+}
+
+# transfers dbonds and prints receivers and names of all actions in the trace
+function transfer_trace {
+	sleep 3
+	cleos -u $API_URL push action $DBONDS transfer '["'$1'", "'$2'", "'"$3"'", ""]' -p $1@active --json \
+		| jq -r '.processed.action_traces[] | .receiver + ":" + .act.name'
+}
+
+EVENT_TRANSFER=1
+
+title "SUBSCRIPTION TESTS"
+
+title "DIRECT NOTIFICATION"
+init_test
+must_pass "subscribe to transfers" subscribe $counterparty $EVENT_TRANSFER false
+trace=`transfer_trace $emitent $counterparty "1.00 $bond_name"`
+must_pass "subscriber is notified" grep -q "^$counterparty:transfer$" <<< "$trace"
+must_fail "no logevents in direct mode" grep -q ":logevents$" <<< "$trace"
+
+title "BATCHED EVENTS"
+must_pass "subscribe in batched mode" subscribe $counterparty $EVENT_TRANSFER true
+trace=`transfer_trace $emitent $counterparty "1.00 $bond_name"`
+must_pass "logevents is sent" grep -q "^$DBONDS:logevents$" <<< "$trace"
+must_fail "subscriber is not notified" grep -q "^$counterparty:transfer$" <<< "$trace"
+
+title "UNSUBSCRIBE"
+must_pass "unsubscribe" subscribe $counterparty 0 false
+trace=`transfer_trace $emitent $counterparty "1.00 $bond_name"`
+must_fail "no logevents after unsubscribe" grep -q ":logevents$" <<< "$trace"
+must_fail "no notification after unsubscribe" grep -q "^$counterparty:transfer$" <<< "$trace"
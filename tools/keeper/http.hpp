@@ -0,0 +1,89 @@
+#pragma once
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/*
+ * Plain HTTP/1.0 POST, enough for the chain API of a local nodeos.
+ * https endpoints are not supported, point the keeper at a local node or a proxy.
+ */
+
+namespace http {
+
+  struct endpoint {
+    std::string host;
+    std::string port;
+  };
+
+  endpoint parse_url(const std::string& url) {
+    const std::string scheme = "http://";
+    if(url.compare(0, scheme.size(), scheme) != 0)
+      throw std::runtime_error("only http:// urls are supported: " + url);
+    std::string rest = url.substr(scheme.size());
+    rest = rest.substr(0, rest.find('/'));
+    size_t colon = rest.find(':');
+    if(colon == std::string::npos)
+      return {rest, "80"};
+    return {rest.substr(0, colon), rest.substr(colon + 1)};
+  }
+
+  // returns response body, throws on connection errors and non-2xx statuses
+  std::string post(const endpoint& ep, const std::string& path, const std::string& body) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    if(getaddrinfo(ep.host.c_str(), ep.port.c_str(), &hints, &addrs) != 0)
+      throw std::runtime_error("cannot resolve " + ep.host);
+
+    int fd = -1;
+    for(addrinfo* a = addrs; a; a = a->ai_next) {
+      fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if(fd < 0)
+        continue;
+      if(connect(fd, a->ai_addr, a->ai_addrlen) == 0)
+        break;
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(addrs);
+    if(fd < 0)
+      throw std::runtime_error("cannot connect to " + ep.host + ":" + ep.port);
+
+    std::string request = "POST " + path + " HTTP/1.0\r\n"
+      "Host: " + ep.host + "\r\n"
+      "Content-Type: application/json\r\n"
+      "Content-Length: " + std::to_string(body.size()) + "\r\n"
+      "Connection: close\r\n\r\n" + body;
+    for(size_t sent = 0; sent < request.size(); ) {
+      ssize_t n = send(fd, request.data() + sent, request.size() - sent, 0);
+      if(n <= 0) {
+        close(fd);
+        throw std::runtime_error("send failed");
+      }
+      sent += n;
+    }
+
+    std::string response;
+    char buffer[16384];
+    for(ssize_t n; (n = recv(fd, buffer, sizeof(buffer), 0)) > 0; )
+      response.append(buffer, n);
+    close(fd);
+
+    size_t header_end = response.find("\r\n\r\n");
+    if(header_end == std::string::npos)
+      throw std::runtime_error("malformed http response");
+    size_t status_start = response.find(' ');
+    int status = std::atoi(response.c_str() + status_start + 1);
+    std::string payload = response.substr(header_end + 4);
+    if(status < 200 || status >= 300)
+      throw std::runtime_error("http " + std::to_string(status) + " " + path + ": " + payload);
+    return payload;
+  }
+
+} // namespace http
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Minimal JSON reader for chain API responses. Numbers are kept as text, since
+ * nodeos sends 64-bit values both as numbers and as strings.
+ */
+
+namespace json {
+
+  struct value {
+    enum kind_t { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    kind_t                                     kind = NUL;
+    bool                                       boolean = false;
+    std::string                                text;        // NUMBER and STRING
+    std::vector<value>                         items;       // ARRAY
+    std::vector<std::pair<std::string, value>> fields;      // OBJECT
+
+    // missing keys and indexes give a null value, so lookups can be chained
+    const value& operator[](const std::string& key) const {
+      static const value null;
+      for(const auto& f : fields)
+        if(f.first == key)
+          return f.second;
+      return null;
+    }
+
+    const value& operator[](size_t i) const {
+      static const value null;
+      return i < items.size() ? items[i] : null;
+    }
+
+    bool is_null() const { return kind == NUL; }
+
+    int64_t as_int() const {
+      if(kind != NUMBER && kind != STRING)
+        throw std::runtime_error("json: number expected");
+      return std::strtoll(text.c_str(), nullptr, 10);
+    }
+
+    const std::string& as_string() const {
+      if(kind != STRING && kind != NUMBER)
+        throw std::runtime_error("json: string expected");
+      return text;
+    }
+  };
+
+  class parser {
+  public:
+    explicit parser(const std::string& s) : src(s) {}
+
+    value parse_document() {
+      value v = parse_value();
+      skip_space();
+      if(pos != src.size())
+        fail("trailing characters");
+      return v;
+    }
+
+  private:
+    const std::string& src;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const char* what) {
+      throw std::runtime_error(std::string("json: ") + what + " at " + std::to_string(pos));
+    }
+
+    void skip_space() {
+      while(pos < src.size() && (src[pos] == ' ' || src[pos] == '\t' || src[pos] == '\n' || src[pos] == '\r'))
+        pos++;
+    }
+
+    void expect(char c) {
+      skip_space();
+      if(pos >= src.size() || src[pos] != c)
+        fail("unexpected character");
+      pos++;
+    }
+
+    bool consume(const char* word) {
+      size_t n = std::char_traits<char>::length(word);
+      if(src.compare(pos, n, word) != 0)
+        return false;
+      pos += n;
+      return true;
+    }
+
+    std::string parse_string() {
+      expect('"');
+      std::string out;
+      while(pos < src.size() && src[pos] != '"') {
+        char c = src[pos++];
+        if(c != '\\') {
+          out.push_back(c);
+          continue;
+        }
+        if(pos >= src.size())
+          fail("bad escape");
+        char e = src[pos++];
+        switch(e) {
+          case 'n': out.push_back('\n'); break;
+          case 't': out.push_back('\t'); break;
+          case 'r': out.push_back('\r'); break;
+          case 'b': out.push_back('\b'); break;
+          case 'f': out.push_back('\f'); break;
+          case 'u': {
+            // chain API emits \u only for control characters, keep them as one byte
+            if(pos + 4 > src.size())
+              fail("bad escape");
+            out.push_back(char(std::strtol(src.substr(pos, 4).c_str(), nullptr, 16)));
+            pos += 4;
+            break;
+          }
+          default: out.push_back(e);
+        }
+      }
+      if(pos >= src.size())
+        fail("unterminated string");
+      pos++;
+      return out;
+    }
+
+    value parse_value() {
+      skip_space();
+      if(pos >= src.size())
+        fail("unexpected end");
+      value v;
+      char c = src[pos];
+      if(c == '{') {
+        v.kind = value::OBJECT;
+        pos++;
+        skip_space();
+        if(pos < src.size() && src[pos] == '}') {
+          pos++;
+          return v;
+        }
+        do {
+          std::string key = parse_string();
+          expect(':');
+          v.fields.emplace_back(std::move(key), parse_value());
+          skip_space();
+        } while(pos < src.size() && src[pos] == ',' && ++pos);
+        expect('}');
+      }
+      else if(c == '[') {
+        v.kind = value::ARRAY;
+        pos++;
+        skip_space();
+        if(pos < src.size() && src[pos] == ']') {
+          pos++;
+          return v;
+        }
+        do {
+          v.items.push_back(parse_value());
+          skip_space();
+        } while(pos < src.size() && src[pos] == ',' && ++pos);
+        expect(']');
+      }
+      else if(c == '"') {
+        v.kind = value::STRING;
+        v.text = parse_string();
+      }
+      else if(consume("true")) {
+        v.kind = value::BOOL;
+        v.boolean = true;
+      }
+      else if(consume("false")) {
+        v.kind = value::BOOL;
+      }
+      else if(consume("null")) {
+      }
+      else {
+        size_t start = pos;
+        while(pos < src.size() && (isdigit((unsigned char)src[pos]) || src[pos] == '-' || src[pos] == '+'
+            || src[pos] == '.' || src[pos] == 'e' || src[pos] == 'E'))
+          pos++;
+        if(start == pos)
+          fail("unexpected character");
+        v.kind = value::NUMBER;
+        v.text = src.substr(start, pos - start);
+      }
+      return v;
+    }
+  };
+
+  value parse(const std::string& s) {
+    return parser(s).parse_document();
+  }
+
+  // string literal for building request bodies
+  std::string quote(const std::string& s) {
+    std::string out = "\"";
+    for(char c : s) {
+      if(c == '"' || c == '\\')
+        out.push_back('\\');
+      out.push_back(c);
+    }
+    out.push_back('"');
+    return out;
+  }
+
+} // namespace json
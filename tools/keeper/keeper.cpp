@@ -0,0 +1,302 @@
+#include "json.hpp"
+#include "http.hpp"
+
+#include <daycount.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Keeper: calls updfcdb for fc dbonds when they come due, so that maturity and
+ * retire transitions do not wait for somebody to touch the dbond.
+ *
+ * Follows the chain head through the chain API of a (local) nodeos, tracks every
+ * dbond listed in the contract's fcdbstates table and keeps a min-heap of the next
+ * time each one needs an update. Due dbonds are updated in batches, several
+ * updfcdb actions per transaction, pushed with cleos so that keys stay in the wallet.
+ *
+ * Test mode (--speed K) runs a virtual clock K times faster than the chain head
+ * time, starting at the head time when the keeper starts. The chain itself does not
+ * run faster, so updfcdb pushed by the virtual clock would do nothing; test mode
+ * requires --dry-run and shows when and in which batches dbonds would be updated.
+ */
+
+using namespace std;
+
+namespace {
+
+  // same values as utility::fcdb_state of the contract
+  enum fcdb_state {
+    CREATED = 0,
+    AGREEMENT_SIGNED = 1,
+    CIRCULATING = 2,
+    EXPIRED_PAID_OFF = 3,
+    EXPIRED_TECH_DEFAULTED = 4,
+    EXPIRED_DEFAULTED = 5
+  };
+
+  struct options {
+    string   url       = getenv("API_URL") ? getenv("API_URL") : "http://127.0.0.1:8888";
+    string   contract  = getenv("DBONDS") ? getenv("DBONDS") : "thedbondsacc";
+    string   actor;
+    string   cleos     = "cleos";
+    size_t   batch     = 20;          // updfcdb actions per transaction
+    int64_t  poll_ms   = 500;         // about a block
+    int64_t  rescan    = 60;          // seconds of (virtual) time between table scans
+    int64_t  retry     = 30;          // seconds before a dbond is updated again
+    int64_t  speed     = 0;           // test mode clock speed, 0 means chain time
+    bool     dry_run   = false;
+  };
+
+  // "2020-05-01T12:00:00.500" to seconds since epoch
+  int64_t parse_time(const string& s) {
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+    if(sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &sec) != 6)
+      throw runtime_error("bad time: " + s);
+    return daycount::days_from_civil(y, mo, d) * daycount::day_seconds + h * 3600 + mi * 60 + sec;
+  }
+
+  // symbol_code::raw() of the contract, used as the primary key of dbond tables
+  uint64_t symbol_code_raw(const string& code) {
+    uint64_t raw = 0;
+    for(size_t i = code.size(); i-- > 0; )
+      raw = (raw << 8) | uint8_t(code[i]);
+    return raw;
+  }
+
+  class chain_api {
+  public:
+    explicit chain_api(const string& url) : ep(http::parse_url(url)) {}
+
+    json::value call(const string& path, const string& body) {
+      return json::parse(http::post(ep, path, body));
+    }
+
+    // all rows of a table, following "more"/"next_key" pages
+    void for_each_row(const string& code, const string& scope, const string& table,
+        const function<void(const json::value&)>& visit) {
+      string lower_bound;
+      for(bool more = true; more; ) {
+        string body = "{\"code\":" + json::quote(code) + ",\"scope\":" + json::quote(scope)
+          + ",\"table\":" + json::quote(table) + ",\"json\":true,\"limit\":1000"
+          + (lower_bound.empty() ? "" : ",\"lower_bound\":" + json::quote(lower_bound)) + "}";
+        json::value page = call("/v1/chain/get_table_rows", body);
+        for(const auto& row : page["rows"].items)
+          visit(row);
+        lower_bound = page["next_key"].is_null() ? string() : page["next_key"].as_string();
+        more = page["more"].boolean && !lower_bound.empty();
+      }
+    }
+
+    json::value get_row(const string& code, const string& scope, const string& table, uint64_t key) {
+      string k = json::quote(to_string(key));
+      string body = "{\"code\":" + json::quote(code) + ",\"scope\":" + json::quote(scope)
+        + ",\"table\":" + json::quote(table) + ",\"json\":true,\"limit\":1,\"lower_bound\":" + k
+        + ",\"upper_bound\":" + k + "}";
+      return call("/v1/chain/get_table_rows", body)["rows"][0];
+    }
+
+  private:
+    http::endpoint ep;
+  };
+
+  struct tracked_dbond {
+    string   emitent;
+    int      state = -1;
+    int64_t  maturity_time = 0;
+    int64_t  retire_time = 0;
+    int64_t  not_before = 0;        // set after an update was submitted
+    uint32_t version = 0;           // heap entries with another version are stale
+    bool     scheduled = false;
+  };
+
+  struct due_entry {
+    int64_t  time;
+    uint32_t version;
+    string   dbond_id;
+
+    bool operator>(const due_entry& other) const { return time > other.time; }
+  };
+
+  class keeper {
+  public:
+    explicit keeper(const options& o) : opt(o), api(o.url) {}
+
+    void run() {
+      int64_t last_scan = 0;
+      bool force_scan = true;
+      for(;;) {
+        json::value info = api.call("/v1/chain/get_info", "{}");
+        int64_t head_time = parse_time(info["head_block_time"].as_string());
+        if(start_head == 0)
+          start_head = head_time;
+        int64_t now = clock(head_time);
+
+        if(force_scan || now - last_scan >= opt.rescan) {
+          scan(now);
+          last_scan = now;
+          force_scan = false;
+        }
+
+        vector<string> batch;
+        while(!heap.empty() && heap.top().time <= now && batch.size() < opt.batch) {
+          due_entry e = heap.top();
+          heap.pop();
+          auto it = bonds.find(e.dbond_id);
+          if(it == bonds.end() || it->second.version != e.version)
+            continue;
+          it->second.version++;
+          it->second.scheduled = false;
+          it->second.not_before = now + opt.retry;
+          batch.push_back(e.dbond_id);
+        }
+        if(!batch.empty()) {
+          submit(batch, now);
+          force_scan = true;
+        }
+        else {
+          this_thread::sleep_for(chrono::milliseconds(opt.poll_ms));
+        }
+      }
+    }
+
+  private:
+    options                                                         opt;
+    chain_api                                                       api;
+    map<string, tracked_dbond>                                      bonds;
+    priority_queue<due_entry, vector<due_entry>, greater<due_entry>> heap;
+    int64_t                                                         start_head = 0;
+
+    int64_t clock(int64_t head_time) const {
+      if(opt.speed == 0)
+        return head_time;
+      return start_head + (head_time - start_head) * opt.speed;
+    }
+
+    // time of the next transition updfcdb would make, -1 if none
+    static int64_t next_transition(const tracked_dbond& b) {
+      if(b.state == CIRCULATING)
+        return b.maturity_time;
+      if(b.state == EXPIRED_TECH_DEFAULTED)
+        return b.retire_time;
+      return -1;
+    }
+
+    void scan(int64_t now) {
+      size_t listed = 0;
+      api.for_each_row(opt.contract, opt.contract, "fcdbstates", [&](const json::value& row) {
+        listed++;
+        string id = row["dbond_id"].as_string();
+        int state = int(row["state"].as_int());
+        tracked_dbond& b = bonds[id];
+        if(b.state != state) {
+          // state changed: terms are read again, emitent may have changed them while the
+          //   dbond was CREATED, then the old schedule is dropped
+          b.emitent = row["emitent"].as_string();
+          json::value info = api.get_row(opt.contract, b.emitent, "fcdbond", symbol_code_raw(id));
+          b.maturity_time = parse_time(info["dbond"]["maturity_time"].as_string());
+          b.retire_time = parse_time(info["dbond"]["retire_time"].as_string());
+          b.state = state;
+          b.version++;
+          b.scheduled = false;
+        }
+        if(!b.scheduled) {
+          int64_t due = next_transition(b);
+          if(due >= 0) {
+            heap.push({max(due, b.not_before), b.version, id});
+            b.scheduled = true;
+          }
+        }
+      });
+      cerr << "[keeper] t=" << now << " scanned " << listed << " dbonds, " << heap.size() << " scheduled\n";
+    }
+
+    void submit(const vector<string>& batch, int64_t now) {
+      string actions;
+      for(const auto& id : batch) {
+        if(!actions.empty())
+          actions += ",";
+        actions += "{\"account\":" + json::quote(opt.contract) + ",\"name\":\"updfcdb\",\"authorization\":[{\"actor\":"
+          + json::quote(opt.actor) + ",\"permission\":\"active\"}],\"data\":{\"dbond_id\":" + json::quote(id) + "}}";
+      }
+      string trx = "{\"actions\":[" + actions + "]}";
+
+      cerr << "[keeper] t=" << now << " updfcdb x" << batch.size() << ":";
+      for(const auto& id : batch)
+        cerr << " " << id;
+      cerr << "\n";
+      if(opt.dry_run)
+        return;
+
+      // dbond ids and account names contain no quotes, so single quoting is enough
+      string command = opt.cleos + " -u " + opt.url + " push transaction '" + trx + "' > /dev/null";
+      if(system(command.c_str()) != 0)
+        cerr << "[keeper] transaction failed, will retry in " << opt.retry << "s\n";
+    }
+  };
+
+  void usage() {
+    cerr << "usage: keeper --actor ACCOUNT [options]\n"
+      "  --url URL          chain API of nodeos, http only (default $API_URL or http://127.0.0.1:8888)\n"
+      "  --contract NAME    dbonds contract account (default $DBONDS or thedbondsacc)\n"
+      "  --actor NAME       account authorizing updfcdb, its key must be in the cleos wallet\n"
+      "  --batch N          updfcdb actions per transaction (default 20)\n"
+      "  --poll-ms MS       head polling period (default 500)\n"
+      "  --rescan S         seconds between scans of fcdbstates (default 60)\n"
+      "  --retry S          seconds before a submitted dbond is tried again (default 30)\n"
+      "  --speed K          test mode, clock runs K times faster than chain time, needs --dry-run\n"
+      "  --dry-run          print batches instead of pushing them\n"
+      "  --cleos PATH       cleos binary (default cleos)\n";
+  }
+
+} // namespace
+
+int main(int argc, char** argv) {
+  options opt;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if(i + 1 >= argc) {
+        usage();
+        exit(1);
+      }
+      return argv[++i];
+    };
+    if(arg == "--url")           opt.url = next();
+    else if(arg == "--contract") opt.contract = next();
+    else if(arg == "--actor")    opt.actor = next();
+    else if(arg == "--batch")    opt.batch = stoul(next());
+    else if(arg == "--poll-ms")  opt.poll_ms = stoll(next());
+    else if(arg == "--rescan")   opt.rescan = stoll(next());
+    else if(arg == "--retry")    opt.retry = stoll(next());
+    else if(arg == "--speed")    opt.speed = stoll(next());
+    else if(arg == "--dry-run")  opt.dry_run = true;
+    else if(arg == "--cleos")    opt.cleos = next();
+    else {
+      usage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+  if((opt.actor.empty() || opt.speed != 0) && !opt.dry_run) {
+    usage();
+    return 1;
+  }
+  if(opt.batch == 0)
+    opt.batch = 1;
+
+  try {
+    keeper(opt).run();
+  }
+  catch(const exception& e) {
+    cerr << "[keeper] " << e.what() << "\n";
+    return 1;
+  }
+}
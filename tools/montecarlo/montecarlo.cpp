@@ -0,0 +1,184 @@
+#include "montecarlo.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Stress test of a portfolio of fc dbonds, see montecarlo.hpp for the scenario model.
+ *
+ * The portfolio is a CSV file, one position per line, '#' starts a comment:
+ *   id,face,apr,basis,maturity,retire,unit,state,position,default_prob,liquidation_prob,recovery,retire_rate
+ * face is the payoff price amount per whole dbond and unit the number of smallest dbond
+ * units in a whole dbond, as in the fcdbond table; state is the fcdb_state number;
+ * times are "2021-06-30" or "2021-06-30T12:00:00", UTC.
+ *
+ * Prints the distribution of the portfolio value at the horizon and how every bond
+ * ended up, in paths; amounts are in the smallest units of the payoff asset.
+ */
+
+using namespace std;
+
+namespace {
+
+  // "2020-05-01" or "2020-05-01T12:00:00" to seconds since epoch
+  int64_t parse_time(const string& s) {
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+    int n = sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &sec);
+    if(n != 3 && n != 6)
+      throw runtime_error("bad time: " + s);
+    return daycount::days_from_civil(y, mo, d) * daycount::day_seconds + h * 3600 + mi * 60 + sec;
+  }
+
+  string format_time(int64_t t) {
+    daycount::civil_date c = daycount::civil_from_days(daycount::floor_div(t, daycount::day_seconds));
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%04lld-%02lld-%02lld", (long long)c.y, (long long)c.m, (long long)c.d);
+    return buf;
+  }
+
+  montecarlo::portfolio read_portfolio(const string& path) {
+    ifstream in(path);
+    if(!in)
+      throw runtime_error("cannot open " + path);
+    montecarlo::portfolio p;
+    string line;
+    for(size_t line_no = 1; getline(in, line); line_no++) {
+      line = line.substr(0, line.find('#'));
+      if(line.find_first_not_of(" \t\r") == string::npos)
+        continue;
+      vector<string> f;
+      stringstream ss(line);
+      for(string cell; getline(ss, cell, ','); )
+        f.push_back(cell.substr(cell.find_first_not_of(" \t") == string::npos ? 0 : cell.find_first_not_of(" \t")));
+      if(f.size() != 13)
+        throw runtime_error(path + ":" + to_string(line_no) + ": 13 columns expected");
+      try {
+        montecarlo::bond b;
+        b.id               = f[0];
+        b.face             = stoll(f[1]);
+        b.apr              = uint32_t(stoul(f[2]));
+        b.basis            = uint8_t(stoul(f[3]));
+        b.maturity         = parse_time(f[4]);
+        b.retire           = parse_time(f[5]);
+        b.unit             = stoll(f[6]);
+        b.state            = uint8_t(stoul(f[7]));
+        b.position         = stoll(f[8]);
+        b.default_prob     = stod(f[9]);
+        b.liquidation_prob = stod(f[10]);
+        b.recovery         = stod(f[11]);
+        b.retire_rate      = stod(f[12]);
+        p.add(b);
+      }
+      catch(const exception& e) {
+        throw runtime_error(path + ":" + to_string(line_no) + ": " + e.what());
+      }
+    }
+    if(p.size() == 0)
+      throw runtime_error(path + ": no positions");
+    return p;
+  }
+
+  void report(const montecarlo::portfolio& p, const montecarlo::params& opt, const montecarlo::result& r) {
+    cout << "portfolio    " << p.size() << " positions, " << r.paths << " paths, seed " << opt.seed << "\n"
+         << "period       " << format_time(opt.now) << " .. " << format_time(opt.horizon) << "\n"
+         << fixed << setprecision(0)
+         << "value now    " << r.value_now << "\n"
+         << "full payoff  " << r.max_value << "\n"
+         << "mean         " << r.mean << "\n"
+         << "stddev       " << r.stddev << "\n"
+         << "min          " << r.min << "\n"
+         << "max          " << r.max << "\n";
+    for(double q : {0.01, 0.05, 0.5})
+      cout << "q" << setw(2) << left << int(q * 100) << right << "          " << r.quantile(q) << "\n";
+    cout << "VaR 95%      " << r.value_now - r.quantile(0.05) << "\n"
+         << "VaR 99%      " << r.value_now - r.quantile(0.01) << "\n\n";
+
+    const char* columns[montecarlo::outcome_count] = {
+      "created", "signed", "circulating", "paid_off", "tech_default", "defaulted", "early_retire", "liquidated"
+    };
+    cout << left << setw(14) << "dbond";
+    for(const char* c : columns)
+      cout << right << setw(13) << c;
+    cout << "\n";
+    for(size_t i = 0; i < p.size(); i++) {
+      cout << left << setw(14) << p.id[i];
+      for(size_t k = 0; k < montecarlo::outcome_count; k++)
+        cout << right << setw(13) << r.outcomes[i * montecarlo::outcome_count + k];
+      cout << "\n";
+    }
+    cerr << "[montecarlo] " << setprecision(3) << r.seconds << "s, " << setprecision(0)
+         << double(r.paths) / max(r.seconds, 1e-9) << " paths/s on " << opt.threads << " threads\n";
+  }
+
+  void usage() {
+    cerr << "usage: montecarlo PORTFOLIO.csv [options]\n"
+      "  --now TIME         valuation time (default: current time)\n"
+      "  --horizon TIME     time the portfolio is valued at (default: a year after --now)\n"
+      "  --paths N          scenarios (default 100000)\n"
+      "  --seed N           random seed (default 1)\n"
+      "  --threads N        worker threads (default: hardware concurrency)\n"
+      "  --chunk N          paths a worker takes at once (default 256)\n"
+      "  --bins N           histogram bins for quantiles (default 4096)\n";
+  }
+
+} // namespace
+
+int main(int argc, char** argv) {
+  montecarlo::params opt;
+  opt.now = int64_t(time(nullptr));
+  string portfolio_path;
+  bool has_horizon = false;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if(i + 1 >= argc) {
+        usage();
+        exit(1);
+      }
+      return argv[++i];
+    };
+    try {
+      if(arg == "--now")               opt.now = parse_time(next());
+      else if(arg == "--horizon")    { opt.horizon = parse_time(next()); has_horizon = true; }
+      else if(arg == "--paths")        opt.paths = stoull(next());
+      else if(arg == "--seed")         opt.seed = stoull(next());
+      else if(arg == "--threads")      opt.threads = unsigned(stoul(next()));
+      else if(arg == "--chunk")        opt.chunk = uint32_t(stoul(next()));
+      else if(arg == "--bins")         opt.bins = uint32_t(stoul(next()));
+      else if(arg[0] != '-' && portfolio_path.empty())
+        portfolio_path = arg;
+      else {
+        usage();
+        return arg == "--help" ? 0 : 1;
+      }
+    }
+    catch(const exception& e) {
+      cerr << "[montecarlo] " << arg << ": " << e.what() << "\n";
+      return 1;
+    }
+  }
+  if(portfolio_path.empty()) {
+    usage();
+    return 1;
+  }
+  if(!has_horizon)
+    opt.horizon = opt.now + 365 * daycount::day_seconds;
+  if(opt.threads == 0)
+    opt.threads = max(1u, thread::hardware_concurrency());
+
+  try {
+    montecarlo::portfolio p = read_portfolio(portfolio_path);
+    montecarlo::result r = montecarlo::run(p, opt);
+    report(p, opt, r);
+  }
+  catch(const exception& e) {
+    cerr << "[montecarlo] " << e.what() << "\n";
+    return 1;
+  }
+}
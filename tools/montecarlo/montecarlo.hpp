@@ -0,0 +1,386 @@
+#pragma once
+
+#include <daycount.hpp>
+#include <lifecycle.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Monte Carlo engine valuing a portfolio of fc dbonds under random early retires,
+ * defaults at maturity and liquidations. Bonds move through lifecycle::next_state and
+ * are paid with lifecycle::payoff, the rules updfcdb and retire apply on chain, and
+ * bonds still circulating at the horizon are marked with daycount::price like updfcdb
+ * prices them.
+ *
+ * One path draws, for every bond in CIRCULATING state:
+ *   - early retire by the emitent at an exponential time with rate retire_rate per year;
+ *     before maturity and horizon it pays the payoff price, as force_retire_from_holder;
+ *   - at maturity (updfcdb due): the emitent fails to pay off with default_prob, the
+ *     bond becomes EXPIRED_TECH_DEFAULTED, otherwise EXPIRED_PAID_OFF with the payoff;
+ *   - a tech. defaulted bond is retired by the liquidation agent with liquidation_prob at
+ *     a uniform time before retire_time, the counterparty passes recovery of the payoff
+ *     to holders; otherwise it becomes EXPIRED_DEFAULTED at retire_time and pays nothing.
+ * Bonds in other states keep their state and are marked with the price, which is zero
+ * for expired ones. All payoff prices are taken in the same asset.
+ *
+ * Paths are split in chunks between worker threads that steal from each other when
+ * their own range runs out. Every path has its own random stream derived from the seed
+ * and the path number and values are integers in the smallest units of the payoff asset,
+ * so results do not depend on the number of threads nor on how work was stolen.
+ */
+
+namespace montecarlo {
+
+  // one position, row form for input
+  struct bond {
+    std::string id;
+    int64_t     face = 0;                  // payoff_price amount per whole dbond
+    uint32_t    apr = 0;
+    uint8_t     basis = 0;                 // accrual_basis
+    int64_t     maturity = 0;              // seconds since epoch
+    int64_t     retire = 0;
+    int64_t     unit = 1;                  // smallest dbond units in a whole dbond
+    uint8_t     state = lifecycle::CIRCULATING;
+    int64_t     position = 0;              // smallest dbond units held
+    double      default_prob = 0;          // emitent does not pay off at maturity
+    double      liquidation_prob = 0;      // tech. defaulted bond is liquidated before retire_time
+    double      recovery = 0;              // share of the payoff holders get on liquidation
+    double      retire_rate = 0;           // early retires per year
+  };
+
+  // struct-of-arrays portfolio, the inner loop of a path walks the columns
+  struct portfolio {
+    std::vector<std::string> id;
+    std::vector<int64_t>     face;
+    std::vector<uint32_t>    apr;
+    std::vector<uint8_t>     basis;
+    std::vector<int64_t>     maturity;
+    std::vector<int64_t>     retire;
+    std::vector<int64_t>     unit;
+    std::vector<uint8_t>     state;
+    std::vector<int64_t>     position;
+    std::vector<int64_t>     full_payoff;  // payoff of the whole position
+    std::vector<double>      default_prob;
+    std::vector<double>      liquidation_prob;
+    std::vector<double>      recovery;
+    std::vector<double>      retire_rate;
+
+    size_t size() const { return id.size(); }
+
+    void add(const bond& b) {
+      if(!daycount::valid_basis(b.basis))
+        throw std::runtime_error("bond " + b.id + ": bad accrual basis");
+      if(b.state >= lifecycle::state_count)
+        throw std::runtime_error("bond " + b.id + ": bad state");
+      if(b.unit <= 0 || b.face < 0 || b.position < 0 || b.retire < b.maturity)
+        throw std::runtime_error("bond " + b.id + ": bad terms");
+      id.push_back(b.id);
+      face.push_back(b.face);
+      apr.push_back(b.apr);
+      basis.push_back(b.basis);
+      maturity.push_back(b.maturity);
+      retire.push_back(b.retire);
+      unit.push_back(b.unit);
+      state.push_back(b.state);
+      position.push_back(b.position);
+      full_payoff.push_back(lifecycle::payoff(b.position, b.face, b.unit));
+      default_prob.push_back(b.default_prob);
+      liquidation_prob.push_back(b.liquidation_prob);
+      recovery.push_back(b.recovery);
+      retire_rate.push_back(b.retire_rate);
+    }
+  };
+
+  struct params {
+    int64_t  now = 0;                      // seconds since epoch
+    int64_t  horizon = 0;
+    uint64_t paths = 100000;
+    uint64_t seed = 1;
+    unsigned threads = 0;                  // 0: hardware concurrency
+    uint32_t chunk = 256;                  // paths taken from a range at once
+    uint32_t bins = 4096;                  // histogram resolution for quantiles
+  };
+
+  // how a bond ended up at the horizon, besides lifecycle states
+  enum outcome: uint8_t {
+    EARLY_RETIRED = lifecycle::state_count,
+    LIQUIDATED,
+    outcome_count
+  };
+
+  struct result {
+    uint64_t              paths = 0;
+    int64_t               value_now = 0;   // portfolio marked at now
+    int64_t               max_value = 0;   // every position paid in full
+    double                mean = 0;
+    double                stddev = 0;
+    int64_t               min = 0;
+    int64_t               max = 0;
+    std::vector<uint64_t> histogram;       // path values in bins of [0, max_value]
+    std::vector<uint64_t> outcomes;        // outcome_count per bond, [bond * outcome_count + outcome]
+    double                seconds = 0;
+
+    // lower edge of the bin where the q-th share of paths is reached
+    int64_t quantile(double q) const {
+      uint64_t target = uint64_t(std::ceil(q * double(paths)));
+      uint64_t seen = 0;
+      for(size_t b = 0; b < histogram.size(); b++) {
+        seen += histogram[b];
+        if(seen >= target && seen != 0)
+          return int64_t((__int128)max_value * b / histogram.size());
+      }
+      return max_value;
+    }
+  };
+
+  /*
+   * random numbers: splitmix64 stream per path
+   */
+  struct rng {
+    uint64_t s;
+
+    rng(uint64_t seed, uint64_t path) : s(seed) {
+      s ^= next() + path * 0xd1342543de82ef95ull;
+    }
+
+    uint64_t next() {
+      uint64_t z = (s += 0x9e3779b97f4a7c15ull);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    double uniform() {
+      return double(next() >> 11) * 0x1.0p-53;
+    }
+  };
+
+  /*
+   * range of paths owned by a worker, begin and end packed in one word so that the
+   * owner (taking chunks from the front) and thieves (taking the back half) only CAS
+   */
+  class alignas(64) path_range {
+  public:
+    void reset(uint32_t begin, uint32_t end) {
+      packed.store(pack(begin, end), std::memory_order_release);
+    }
+
+    bool take_front(uint32_t n, uint32_t& begin, uint32_t& end) {
+      uint64_t cur = packed.load(std::memory_order_acquire);
+      for(;;) {
+        uint32_t b = uint32_t(cur >> 32), e = uint32_t(cur);
+        if(b >= e)
+          return false;
+        uint32_t take = std::min(n, e - b);
+        if(packed.compare_exchange_weak(cur, pack(b + take, e), std::memory_order_acq_rel)) {
+          begin = b;
+          end = b + take;
+          return true;
+        }
+      }
+    }
+
+    bool steal_back(uint32_t& begin, uint32_t& end) {
+      uint64_t cur = packed.load(std::memory_order_acquire);
+      for(;;) {
+        uint32_t b = uint32_t(cur >> 32), e = uint32_t(cur);
+        if(b >= e)
+          return false;
+        uint32_t mid = e - std::max<uint32_t>(1, (e - b) / 2);
+        if(packed.compare_exchange_weak(cur, pack(b, mid), std::memory_order_acq_rel)) {
+          begin = mid;
+          end = e;
+          return true;
+        }
+      }
+    }
+
+  private:
+    std::atomic<uint64_t> packed{0};
+
+    static uint64_t pack(uint32_t begin, uint32_t end) {
+      return (uint64_t(begin) << 32) | end;
+    }
+  };
+
+  // written by one worker only, merged after the workers are joined
+  struct alignas(64) worker_totals {
+    uint64_t              paths = 0;
+    __int128              sum = 0;
+    __int128              sum_sq = 0;
+    int64_t               min = INT64_MAX;
+    int64_t               max = INT64_MIN;
+    std::vector<uint64_t> histogram;
+    std::vector<uint64_t> outcomes;
+  };
+
+  class engine {
+  public:
+    engine(const portfolio& p, const params& o) : pf(p), opt(o) {
+      if(opt.horizon < opt.now)
+        throw std::runtime_error("horizon is before now");
+      if(opt.paths == 0 || opt.paths > UINT32_MAX)
+        throw std::runtime_error("paths must be in 1..2^32-1");
+      if(opt.threads == 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+      opt.chunk = std::max<uint32_t>(1, opt.chunk);
+      opt.bins = std::max<uint32_t>(1, opt.bins);
+      for(size_t i = 0; i < pf.size(); i++) {
+        max_value += pf.full_payoff[i];
+        if(!lifecycle::is_final(lifecycle::state(pf.state[i])))
+          value_now += mark(i, opt.now);
+      }
+    }
+
+    result run() {
+      auto started = std::chrono::steady_clock::now();
+      unsigned n = opt.threads;
+      std::vector<path_range> ranges(n);
+      std::vector<worker_totals> totals(n);
+      uint64_t per = opt.paths / n, extra = opt.paths % n, begin = 0;
+      for(unsigned w = 0; w < n; w++) {
+        uint64_t end = begin + per + (w < extra ? 1 : 0);
+        ranges[w].reset(uint32_t(begin), uint32_t(end));
+        begin = end;
+      }
+
+      std::vector<std::thread> workers;
+      for(unsigned w = 0; w < n; w++)
+        workers.emplace_back([&, w]() { work(w, ranges, totals[w]); });
+      for(auto& t : workers)
+        t.join();
+
+      result r;
+      r.value_now = value_now;
+      r.max_value = max_value;
+      r.histogram.assign(opt.bins, 0);
+      r.outcomes.assign(pf.size() * outcome_count, 0);
+      __int128 sum = 0, sum_sq = 0;
+      r.min = INT64_MAX;
+      r.max = INT64_MIN;
+      for(const auto& t : totals) {
+        r.paths += t.paths;
+        sum += t.sum;
+        sum_sq += t.sum_sq;
+        r.min = std::min(r.min, t.min);
+        r.max = std::max(r.max, t.max);
+        for(size_t b = 0; b < t.histogram.size(); b++)
+          r.histogram[b] += t.histogram[b];
+        for(size_t k = 0; k < t.outcomes.size(); k++)
+          r.outcomes[k] += t.outcomes[k];
+      }
+      r.mean = double(sum) / double(r.paths);
+      double var = (double(sum_sq) - double(sum) * r.mean) / double(r.paths);
+      r.stddev = var > 0 ? std::sqrt(var) : 0;
+      r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+      return r;
+    }
+
+  private:
+    const portfolio& pf;
+    params           opt;
+    int64_t          value_now = 0;
+    int64_t          max_value = 0;
+
+    // position priced at time t the way updfcdb prices the dbond
+    int64_t mark(size_t i, int64_t t) const {
+      int64_t price = daycount::price(pf.basis[i], pf.face[i], pf.apr[i], t, pf.maturity[i]);
+      return lifecycle::payoff(pf.position[i], price, pf.unit[i]);
+    }
+
+    void work(unsigned self, std::vector<path_range>& ranges, worker_totals& t) {
+      t.histogram.assign(opt.bins, 0);
+      t.outcomes.assign(pf.size() * outcome_count, 0);
+      unsigned n = unsigned(ranges.size());
+      uint32_t begin, end;
+      for(;;) {
+        while(ranges[self].take_front(opt.chunk, begin, end))
+          for(uint32_t p = begin; p < end; p++)
+            account(t, simulate(p, t));
+
+        // own range is empty: take the back half of the first victim that has paths left
+        bool stolen = false;
+        for(unsigned k = 1; k < n && !stolen; k++) {
+          if(ranges[(self + k) % n].steal_back(begin, end)) {
+            ranges[self].reset(begin, end);
+            stolen = true;
+          }
+        }
+        if(!stolen)
+          return;
+      }
+    }
+
+    void account(worker_totals& t, int64_t value) const {
+      t.paths++;
+      t.sum += value;
+      t.sum_sq += (__int128)value * value;
+      t.min = std::min(t.min, value);
+      t.max = std::max(t.max, value);
+      size_t bin = max_value > 0 ? size_t((__int128)value * opt.bins / max_value) : 0;
+      t.histogram[std::min<size_t>(bin, opt.bins - 1)]++;
+    }
+
+    // portfolio value at the horizon on path p: payoffs received plus marks of open bonds
+    int64_t simulate(uint64_t p, worker_totals& t) const {
+      rng r(opt.seed, p);
+      const double year = 365.0 * daycount::day_seconds;
+      int64_t value = 0;
+      for(size_t i = 0; i < pf.size(); i++) {
+        // four draws for every bond, so that a bond sees the same numbers whatever the others do
+        double u_retire = r.uniform(), u_default = r.uniform(), u_liquidate = r.uniform(), u_when = r.uniform();
+        int64_t maturity = pf.maturity[i], retire = pf.retire[i];
+        auto paid_off = [&]() { return u_default >= pf.default_prob[i]; };
+        lifecycle::state s = lifecycle::state(pf.state[i]);
+
+        if(s == lifecycle::CIRCULATING) {
+          int64_t retire_at = pf.retire_rate[i] > 0
+            ? opt.now + int64_t(-std::log1p(-u_retire) / pf.retire_rate[i] * year)
+            : INT64_MAX;
+          if(retire_at < maturity && retire_at <= opt.horizon) {
+            // retire by the emitent buys every holder out at the payoff price
+            t.outcomes[i * outcome_count + EARLY_RETIRED]++;
+            value += pf.full_payoff[i];
+            continue;
+          }
+          if(maturity <= opt.horizon) {
+            s = lifecycle::next_state(s, maturity, maturity, retire, paid_off);
+            if(s == lifecycle::EXPIRED_PAID_OFF)
+              value += pf.full_payoff[i];
+          }
+        }
+
+        if(s == lifecycle::EXPIRED_TECH_DEFAULTED) {
+          int64_t from = std::max(maturity, opt.now);
+          int64_t liquidate_at = from + int64_t(u_when * double(std::max<int64_t>(retire - from, 0)));
+          if(u_liquidate < pf.liquidation_prob[i] && liquidate_at <= opt.horizon && liquidate_at < retire) {
+            t.outcomes[i * outcome_count + LIQUIDATED]++;
+            value += int64_t(double(pf.full_payoff[i]) * pf.recovery[i]);
+            continue;
+          }
+          if(retire <= opt.horizon)
+            s = lifecycle::next_state(s, retire, maturity, retire, paid_off);
+        }
+        else if(!lifecycle::is_final(s)) {
+          value += mark(i, opt.horizon);
+        }
+        t.outcomes[i * outcome_count + s]++;
+      }
+      return value;
+    }
+  };
+
+  result run(const portfolio& p, const params& o) {
+    return engine(p, o).run();
+  }
+
+} // namespace montecarlo
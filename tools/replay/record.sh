@@ -0,0 +1,66 @@
+#!/bin/bash
+# Records actions which reached the dbonds contract, oldest first, from the history
+# API (v1 history plugin, nodeos 2.0 traces) of $API_URL and saves the deployed code
+# as the baseline build for replay.sh.
+#
+# usage: record.sh OUTDIR [MAX_ACTIONS]
+#
+#   OUTDIR/actions.jsonl    one action per line: seq, block_time, trx_id, account, name,
+#                           authorization, data, hex_data, elapsed (contract time, us)
+#   OUTDIR/baseline.wasm    code and abi deployed at $DBONDS when recorded
+#   OUTDIR/baseline.abi
+#
+# Only actions sent by users are kept: direct dbonds actions and token transfers
+# dbonds was notified about. Inline actions are produced again by the contract on replay.
+
+set -e
+
+out=$1
+max=${2:-1000}
+page=100
+
+if [[ -z "$out" || -z "$DBONDS" || -z "$API_URL" ]] ; then
+	echo "usage: DBONDS=account API_URL=url $0 OUTDIR [MAX_ACTIONS]" >&2
+	exit 1
+fi
+
+mkdir -p "$out"
+raw="$out/actions.raw"
+: > "$raw"
+
+pos=0
+while [[ $pos -lt $((max * 4)) ]] ; do
+	resp=`curl -sf -X POST "$API_URL/v1/history/get_actions" \
+		-d "{\"account_name\":\"$DBONDS\",\"pos\":$pos,\"offset\":$((page - 1))}"`
+	n=`jq '.actions | length' <<< "$resp"`
+	[[ $n = 0 ]] && break
+	jq -c '.actions[]' <<< "$resp" >> "$raw"
+	pos=$((pos + n))
+	echo "fetched $pos action receipts" >&2
+done
+
+# A user action has no creator; the receipt dbonds got for it is either the action
+# itself or its notification, in which case the notified action is the closest ancestor.
+jq -c '
+	.action_trace as $t
+	| select(($t.creator_action_ordinal // 0) == 0)
+	| {
+		seq:           .account_action_seq,
+		block_time:    .block_time,
+		trx_id:        $t.trx_id,
+		ordinal:       (if $t.receiver == $t.act.account then $t.action_ordinal
+		                else $t.closest_unnotified_ancestor_action_ordinal end),
+		account:       $t.act.account,
+		name:          $t.act.name,
+		authorization: $t.act.authorization,
+		data:          $t.act.data,
+		hex_data:      $t.act.hex_data,
+		elapsed:       $t.elapsed
+	}' "$raw" \
+| jq -s -c 'unique_by([.trx_id, .ordinal]) | sort_by(.seq) | .[]' \
+| head -n "$max" > "$out/actions.jsonl"
+rm -f "$raw"
+
+cleos -u "$API_URL" get code "$DBONDS" --wasm -c "$out/baseline.wasm" -a "$out/baseline.abi" > /dev/null
+
+echo "`wc -l < "$out/actions.jsonl"` actions recorded to $out/actions.jsonl" >&2
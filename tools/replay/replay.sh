@@ -0,0 +1,205 @@
+#!/bin/bash
+# Replays actions recorded by record.sh against the recorded (baseline) and a candidate
+# build of dbonds on a local chain, then compares per-action CPU and all table rows.
+#
+# usage: replay.sh RECORD_DIR CANDIDATE.wasm CANDIDATE.abi
+#
+# Environment:
+#   DBONDS      contract account the record was taken from
+#   LOCAL_URL   local nodeos with producer and chain API (default http://127.0.0.1:8888)
+#   LOCAL_KEY   public key of the eosio account, unlocked in the cleos wallet
+#               (default: the eosio development key)
+#   TOKEN_DIR   directory with eosio.token.wasm and eosio.token.abi
+#   BASE_ACC    account getting the baseline build (default dbondsbase)
+#   CAND_ACC    account getting the candidate build (default dbondscand)
+#
+# Every recorded action is pushed twice, to the baseline and to the candidate account,
+# with the recorded contract name replaced by the target one in data and authorizations.
+# Both pushes go into the same block time window, so time dependent checks see the
+# same chain time; it is the time of the replay, not the recorded block_time.
+# Accounts and tokens named in the record are created first, every token gets a large
+# supply spread over the accounts sending it.
+#
+# Results in RECORD_DIR/replay/:
+#   results.jsonl        per action: name, status and contract CPU of both builds
+#   cpu.txt              CPU per action name: count, baseline, candidate, recorded
+#   tables.base.jsonl    table rows of both builds with contract names normalized
+#   tables.cand.jsonl
+#   tables.diff          diff of the above, empty when the builds agree
+
+set -e
+
+rec=$1
+cand_wasm=$2
+cand_abi=$3
+
+LOCAL_URL=${LOCAL_URL:-http://127.0.0.1:8888}
+LOCAL_KEY=${LOCAL_KEY:-EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV}
+BASE_ACC=${BASE_ACC:-dbondsbase}
+CAND_ACC=${CAND_ACC:-dbondscand}
+
+if [[ -z "$rec" || -z "$cand_wasm" || -z "$cand_abi" || -z "$DBONDS" || -z "$TOKEN_DIR" ]] ; then
+	echo "usage: DBONDS=account TOKEN_DIR=dir $0 RECORD_DIR CANDIDATE.wasm CANDIDATE.abi" >&2
+	exit 1
+fi
+
+actions="$rec/actions.jsonl"
+out="$rec/replay"
+mkdir -p "$out"
+
+cl() {
+	cleos -u "$LOCAL_URL" "$@" < /dev/null
+}
+
+create_account() {
+	cl get account "$1" > /dev/null 2>&1 || cl create account eosio "$1" "$LOCAL_KEY" "$LOCAL_KEY" > /dev/null
+}
+
+# contract with eosio.code, so that it can send inline actions
+deploy() {
+	account=$1
+	wasm=$2
+	abi=$3
+	create_account "$account"
+	dir=`mktemp -d`
+	cp "$wasm" "$dir/contract.wasm"
+	cp "$abi" "$dir/contract.abi"
+	cl set contract "$account" "$dir" contract.wasm contract.abi > /dev/null
+	rm -rf "$dir"
+	cl set account permission "$account" active --add-code > /dev/null
+}
+
+# record line with the dbonds account replaced by $1
+retarget() {
+	jq -c --arg old "$DBONDS" --arg new "$1" '
+		walk(if type == "string" and . == $old then $new else . end)
+		| {account, name, authorization, data}' <<< "$2"
+}
+
+# ----------------------------------------------------------------------------------------
+# accounts and tokens
+# ----------------------------------------------------------------------------------------
+
+echo "creating accounts" >&2
+jq -r --arg self "$DBONDS" '
+	[.authorization[].actor, (.data | .. | strings | select(test("^[a-z1-5.]{1,12}$")))]
+	| .[] | select(. != $self)' "$actions" | sort -u | while read account ; do
+	create_account "$account"
+done
+
+# token contracts: recorded transfers to dbonds and contracts of extended assets in data,
+#   with every symbol seen for them
+jq -r --arg self "$DBONDS" '
+	(select(.account != $self and .data.quantity != null) | "\(.account) \(.data.quantity)"),
+	(.data | .. | objects | select(has("contract") and has("quantity"))
+		| select(.contract != $self) | "\(.contract) \(.quantity)")' "$actions" \
+| awk '{ print $1, $3, $2 }' | sort -u -k1,2 > "$out/tokens.txt"
+
+echo "deploying tokens" >&2
+cut -d ' ' -f 1 "$out/tokens.txt" | sort -u | while read token ; do
+	deploy "$token" "$TOKEN_DIR/eosio.token.wasm" "$TOKEN_DIR/eosio.token.abi"
+done
+while read token symbol sample ; do
+	decimals=`awk -F. '{ print (NF > 1) ? length($2) : 0 }' <<< "$sample"`
+	fraction=""
+	[[ $decimals -gt 0 ]] && fraction=".`printf '%0*d' $decimals 0`"
+	cl push action "$token" create "[\"$token\", \"1000000000$fraction $symbol\"]" -p "$token" > /dev/null 2>&1 || true
+	cl push action "$token" issue "[\"$token\", \"1000000000$fraction $symbol\", \"replay\"]" -p "$token" > /dev/null
+	senders=`jq -r --arg t "$token" 'select(.account == $t) | .data.from' "$actions" | sort -u`
+	for sender in $senders ; do
+		[[ "$sender" = "$DBONDS" ]] && continue
+		cl push action "$token" transfer "[\"$token\", \"$sender\", \"1000000$fraction $symbol\", \"replay\"]" -p "$token" > /dev/null
+	done
+done < "$out/tokens.txt"
+
+echo "deploying builds" >&2
+deploy "$BASE_ACC" "$rec/baseline.wasm" "$rec/baseline.abi"
+deploy "$CAND_ACC" "$cand_wasm" "$cand_abi"
+
+# ----------------------------------------------------------------------------------------
+# replay
+# ----------------------------------------------------------------------------------------
+
+# pushes one action, prints "status us": contract time of all receipts of the target
+push() {
+	target=$1
+	act=`retarget "$target" "$2"`
+	if resp=`cl push transaction --json -f "{\"actions\":[$act]}" 2> "$out/last_error"` ; then
+		us=`jq --arg t "$target" '[.processed.action_traces[] | select(.receiver == $t) | .elapsed] | add // 0' <<< "$resp"`
+		echo "ok $us"
+	else
+		echo "failed 0"
+	fi
+}
+
+echo "replaying `wc -l < "$actions"` actions" >&2
+: > "$out/results.jsonl"
+i=0
+while IFS= read -r line ; do
+	read base_status base_us <<< "`push "$BASE_ACC" "$line"`"
+	read cand_status cand_us <<< "`push "$CAND_ACC" "$line"`"
+	jq -c --argjson i $i --arg bs "$base_status" --argjson bu "$base_us" --arg cs "$cand_status" --argjson cu "$cand_us" '
+		{i: $i, name, recorded_us: (.elapsed // 0), base: $bs, base_us: $bu, cand: $cs, cand_us: $cu}' <<< "$line" \
+		>> "$out/results.jsonl"
+	if [[ "$base_status" != "$cand_status" ]] ; then
+		echo "action $i (`jq -r .name <<< "$line"`): baseline $base_status, candidate $cand_status" >&2
+	fi
+	i=$((i + 1))
+done < "$actions"
+
+jq -s -r '
+	group_by(.name)
+	| map({
+		name: .[0].name,
+		n: length,
+		base: ([.[] | select(.base == "ok") | .base_us] | add // 0),
+		cand: ([.[] | select(.cand == "ok") | .cand_us] | add // 0),
+		recorded: ([.[] | .recorded_us] | add // 0)
+	})
+	| (["action", "count", "base_us", "cand_us", "cand/base", "recorded_us"] | @tsv),
+	  (.[] | [.name, .n, .base, .cand,
+	          (if .base > 0 then (.cand / .base * 100 | round / 100) else "-" end), .recorded] | @tsv)
+	' "$out/results.jsonl" | column -t > "$out/cpu.txt"
+cat "$out/cpu.txt"
+
+mismatches=`jq -s '[.[] | select(.base != .cand)] | length' "$out/results.jsonl"`
+echo "$mismatches actions with different status" >&2
+
+# ----------------------------------------------------------------------------------------
+# table states
+# ----------------------------------------------------------------------------------------
+
+# every row of every table of $1 as {table, scope, row}, contract name normalized
+dump_tables() {
+	code=$1
+	lower=""
+	while : ; do
+		resp=`curl -sf -X POST "$LOCAL_URL/v1/chain/get_table_by_scope" \
+			-d "{\"code\":\"$code\",\"limit\":1000,\"lower_bound\":\"$lower\"}"`
+		jq -r '.rows[] | "\(.table) \(.scope)"' <<< "$resp"
+		lower=`jq -r '.more' <<< "$resp"`
+		[[ -z "$lower" ]] && break
+	done | while read table scope ; do
+		more=true
+		next=""
+		while [[ "$more" = "true" ]] ; do
+			resp=`curl -sf -X POST "$LOCAL_URL/v1/chain/get_table_rows" \
+				-d "{\"code\":\"$code\",\"scope\":\"$scope\",\"table\":\"$table\",\"json\":true,\"limit\":1000,\"lower_bound\":\"$next\"}"`
+			jq -c --arg table "$table" --arg scope "$scope" --arg code "$code" --arg self "$DBONDS" '
+				.rows[] | {table: $table, scope: (if $scope == $code then $self else $scope end), row: .}
+				| walk(if type == "string" and . == $code then $self else . end)' <<< "$resp"
+			more=`jq -r '.more' <<< "$resp"`
+			next=`jq -r '.next_key // ""' <<< "$resp"`
+			[[ -z "$next" ]] && more=false
+		done
+	done | sort
+}
+
+echo "comparing tables" >&2
+dump_tables "$BASE_ACC" > "$out/tables.base.jsonl"
+dump_tables "$CAND_ACC" > "$out/tables.cand.jsonl"
+if diff -u "$out/tables.base.jsonl" "$out/tables.cand.jsonl" > "$out/tables.diff" ; then
+	echo "tables are equal (`wc -l < "$out/tables.base.jsonl"` rows)"
+else
+	echo "tables differ, see $out/tables.diff"
+fi
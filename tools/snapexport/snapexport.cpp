@@ -0,0 +1,508 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Exports dbonds contract tables from a nodeos portable snapshot into columnar files.
+ *
+ * The snapshot is mapped into memory and rows are decoded in place, following the
+ * contract's row layouts (currency_stats, account, fc_dbond_stats, fc_dbond_order_struct).
+ * Every table gets a directory with one file per column:
+ *   <column>.bin             little-endian fixed-width values, one per row
+ *   <column>.offsets/.data   variable-length values: uint64 end offsets into .data
+ *   schema.txt               column names and types in file order
+ * Names, symbol codes and symbols are written as their raw uint64 values.
+ * Rows which do not decode with the current layout (e.g. fcdbond rows not yet
+ * migrated by migratefcdb) are skipped and counted.
+ */
+
+using namespace std;
+
+namespace {
+
+  // name::raw() of a name string, as eosio::name does it
+  uint64_t name_value(const string& s) {
+    auto char_to_value = [](char c) -> uint64_t {
+      if(c == '.') return 0;
+      if(c >= '1' && c <= '5') return c - '1' + 1;
+      if(c >= 'a' && c <= 'z') return c - 'a' + 6;
+      throw runtime_error("bad character in name");
+    };
+    if(s.size() > 13)
+      throw runtime_error("name is too long: " + s);
+    uint64_t value = 0;
+    for(size_t i = 0; i < 12 && i < s.size(); i++)
+      value |= (char_to_value(s[i]) & 0x1f) << (64 - 5 * (i + 1));
+    if(s.size() == 13)
+      value |= char_to_value(s[12]) & 0x0f;
+    return value;
+  }
+
+  /*
+   * bounds checked little-endian reader over mapped memory
+   */
+  struct reader {
+    const char* pos;
+    const char* end;
+
+    void need(size_t n) const {
+      if(size_t(end - pos) < n)
+        throw runtime_error("unexpected end of data");
+    }
+
+    template<typename T>
+    T get() {
+      need(sizeof(T));
+      T v;
+      memcpy(&v, pos, sizeof(T));
+      pos += sizeof(T);
+      return v;
+    }
+
+    uint32_t varuint() {
+      uint64_t v = 0;
+      for(int shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = get<uint8_t>();
+        v |= uint64_t(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+          return uint32_t(v);
+      }
+      throw runtime_error("bad varuint");
+    }
+
+    string_view bytes(size_t n) {
+      need(n);
+      string_view v(pos, n);
+      pos += n;
+      return v;
+    }
+
+    string_view str() { return bytes(varuint()); }
+
+    string_view cstr() {
+      const char* start = pos;
+      while(pos < end && *pos)
+        pos++;
+      need(1);
+      return string_view(start, pos++ - start);
+    }
+
+    void skip(size_t n) { bytes(n); }
+  };
+
+  /*
+   * columnar output
+   */
+  class column {
+  public:
+    column(const string& dir, const string& file, FILE* schema, const string& name, const string& type) {
+      f = fopen((dir + "/" + file).c_str(), "wb");
+      if(!f)
+        throw runtime_error("cannot create " + dir + "/" + file);
+      if(schema)
+        fprintf(schema, "%s %s\n", name.c_str(), type.c_str());
+    }
+
+    ~column() {
+      flush();
+      fclose(f);
+    }
+
+    template<typename T>
+    void put(const T& v) {
+      append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void append(const char* data, size_t n) {
+      buffer.insert(buffer.end(), data, data + n);
+      if(buffer.size() >= (1 << 20))
+        flush();
+    }
+
+  private:
+    FILE* f;
+    vector<char> buffer;
+
+    void flush() {
+      if(!buffer.empty() && fwrite(buffer.data(), 1, buffer.size(), f) != buffer.size())
+        throw runtime_error("write failed");
+      buffer.clear();
+    }
+  };
+
+  class var_column {
+  public:
+    var_column(const string& dir, FILE* schema, const string& name, const string& type)
+      : offsets(dir, name + ".offsets", schema, name, type), data(dir, name + ".data", nullptr, name, type) {}
+
+    void put(string_view v) {
+      data.append(v.data(), v.size());
+      end += v.size();
+      offsets.put(end);
+    }
+
+  private:
+    column offsets;
+    column data;
+    uint64_t end = 0;
+  };
+
+  class table_dir {
+  public:
+    explicit table_dir(const string& d) : dir(d) {
+      mkdir(dir.c_str(), 0755);
+      schema = fopen((dir + "/schema.txt").c_str(), "w");
+      if(!schema)
+        throw runtime_error("cannot create " + dir + "/schema.txt");
+    }
+
+    ~table_dir() { fclose(schema); }
+
+    unique_ptr<column> fixed(const string& name, const string& type) {
+      return make_unique<column>(dir, name + ".bin", schema, name, type);
+    }
+
+    unique_ptr<var_column> var(const string& name, const string& type) {
+      return make_unique<var_column>(dir, schema, name, type);
+    }
+
+  private:
+    string dir;
+    FILE* schema;
+  };
+
+  // asset: int64 amount, uint64 symbol
+  struct asset_columns {
+    unique_ptr<column> amount;
+    unique_ptr<column> symbol;
+
+    asset_columns(table_dir& t, const string& prefix)
+      : amount(t.fixed(prefix + "_amount", "int64")), symbol(t.fixed(prefix + "_symbol", "symbol")) {}
+
+    void put(reader& r) {
+      amount->put(r.get<int64_t>());
+      symbol->put(r.get<uint64_t>());
+    }
+  };
+
+  // extended_asset: asset, name contract
+  struct extended_asset_columns : asset_columns {
+    unique_ptr<column> contract;
+
+    extended_asset_columns(table_dir& t, const string& prefix)
+      : asset_columns(t, prefix), contract(t.fixed(prefix + "_contract", "name")) {}
+
+    void put(reader& r) {
+      asset_columns::put(r);
+      contract->put(r.get<uint64_t>());
+    }
+  };
+
+  /*
+   * tables, add() gets scope, primary key and the row data
+   */
+  struct stat_table {
+    table_dir t;
+    unique_ptr<column> dbond_id;
+    asset_columns supply;
+    asset_columns max_supply;
+    unique_ptr<column> issuer;
+
+    explicit stat_table(const string& dir)
+      : t(dir + "/stat"), dbond_id(t.fixed("dbond_id", "symbol_code")),
+        supply(t, "supply"), max_supply(t, "max_supply"), issuer(t.fixed("issuer", "name")) {}
+
+    void add(uint64_t, uint64_t key, reader r) {
+      dbond_id->put(key);
+      supply.put(r);
+      max_supply.put(r);
+      issuer->put(r.get<uint64_t>());
+    }
+  };
+
+  struct accounts_table {
+    table_dir t;
+    unique_ptr<column> owner;
+    unique_ptr<column> dbond_id;
+    asset_columns balance;
+
+    explicit accounts_table(const string& dir)
+      : t(dir + "/accounts"), owner(t.fixed("owner", "name")), dbond_id(t.fixed("dbond_id", "symbol_code")),
+        balance(t, "balance") {}
+
+    void add(uint64_t scope, uint64_t key, reader r) {
+      owner->put(scope);
+      dbond_id->put(key);
+      balance.put(r);
+    }
+  };
+
+  struct fcdbond_table {
+    table_dir t;
+    // fc_dbond
+    unique_ptr<column> dbond_id;
+    unique_ptr<column> emitent;
+    asset_columns quantity_to_issue;
+    unique_ptr<column> maturity_time;
+    unique_ptr<column> retire_time;
+    extended_asset_columns payoff_price;
+    unique_ptr<column> fungible;
+    unique_ptr<var_column> additional_info;
+    unique_ptr<column> collateral_isin;
+    unique_ptr<column> verifier;
+    unique_ptr<column> counterparty;
+    unique_ptr<column> liquidation_agent;
+    unique_ptr<var_column> escrow_contract_link;
+    unique_ptr<column> apr;
+    unique_ptr<column> accrual_basis;
+    unique_ptr<var_column> holders_list;
+    // fc_dbond_stats
+    unique_ptr<column> initial_time;
+    extended_asset_columns initial_price;
+    extended_asset_columns current_price;
+    unique_ptr<column> state_flags;
+    unique_ptr<column> unit;
+
+    explicit fcdbond_table(const string& dir)
+      : t(dir + "/fcdbond"),
+        dbond_id(t.fixed("dbond_id", "symbol_code")),
+        emitent(t.fixed("emitent", "name")),
+        quantity_to_issue(t, "quantity_to_issue"),
+        maturity_time(t.fixed("maturity_time", "time_point")),
+        retire_time(t.fixed("retire_time", "time_point")),
+        payoff_price(t, "payoff_price"),
+        fungible(t.fixed("fungible", "bool")),
+        additional_info(t.var("additional_info", "string")),
+        collateral_isin(t.fixed("collateral_isin", "uint64")),
+        verifier(t.fixed("verifier", "name")),
+        counterparty(t.fixed("counterparty", "name")),
+        liquidation_agent(t.fixed("liquidation_agent", "name")),
+        escrow_contract_link(t.var("escrow_contract_link", "string")),
+        apr(t.fixed("apr", "uint16")),
+        accrual_basis(t.fixed("accrual_basis", "uint8")),
+        holders_list(t.var("holders_list", "name[]")),
+        initial_time(t.fixed("initial_time", "time_point")),
+        initial_price(t, "initial_price"),
+        current_price(t, "current_price"),
+        state_flags(t.fixed("state_flags", "uint8")),
+        unit(t.fixed("unit", "int64")) {}
+
+    // the row is decoded completely before anything is written, so that a row in
+    //   another layout does not leave the columns misaligned
+    static bool valid(reader r) {
+      try {
+        r.skip(8 + 8 + 16 + 8 + 8 + 24 + 1);
+        r.str();
+        r.skip(8 + 8 + 8 + 8);
+        r.str();
+        r.skip(2 + 1);
+        r.skip(size_t(r.varuint()) * 8);
+        r.skip(8 + 24 + 24 + 1 + 8);
+        return r.pos == r.end;
+      }
+      catch(const exception&) {
+        return false;
+      }
+    }
+
+    void add(uint64_t, uint64_t, reader r) {
+      dbond_id->put(r.get<uint64_t>());
+      emitent->put(r.get<uint64_t>());
+      quantity_to_issue.put(r);
+      maturity_time->put(r.get<int64_t>());
+      retire_time->put(r.get<int64_t>());
+      payoff_price.put(r);
+      fungible->put(r.get<uint8_t>());
+      additional_info->put(r.str());
+      collateral_isin->put(r.get<uint64_t>());
+      verifier->put(r.get<uint64_t>());
+      counterparty->put(r.get<uint64_t>());
+      liquidation_agent->put(r.get<uint64_t>());
+      escrow_contract_link->put(r.str());
+      apr->put(r.get<uint16_t>());
+      accrual_basis->put(r.get<uint8_t>());
+      uint32_t holders = r.varuint();
+      holders_list->put(r.bytes(size_t(holders) * 8));
+      initial_time->put(r.get<int64_t>());
+      initial_price.put(r);
+      current_price.put(r);
+      state_flags->put(r.get<uint8_t>());
+      unit->put(r.get<int64_t>());
+    }
+  };
+
+  struct fcdborders_table {
+    table_dir t;
+    unique_ptr<column> dbond_id;
+    unique_ptr<column> seller;
+    unique_ptr<column> buyer;
+    extended_asset_columns recieved_payment;
+    asset_columns recieved_quantity;
+    extended_asset_columns price;
+
+    explicit fcdborders_table(const string& dir)
+      : t(dir + "/fcdborders"), dbond_id(t.fixed("dbond_id", "symbol_code")),
+        seller(t.fixed("seller", "name")), buyer(t.fixed("buyer", "name")),
+        recieved_payment(t, "recieved_payment"), recieved_quantity(t, "recieved_quantity"), price(t, "price") {}
+
+    void add(uint64_t scope, uint64_t, reader r) {
+      dbond_id->put(scope);
+      seller->put(r.get<uint64_t>());
+      buyer->put(r.get<uint64_t>());
+      recieved_payment.put(r);
+      recieved_quantity.put(r);
+      price.put(r);
+    }
+  };
+
+  /*
+   * snapshot walk
+   */
+  const uint32_t snapshot_magic = 0x30510550;
+
+  // sizes of secondary index rows after primary_key and payer: 64, 128, 256 bit,
+  //   double and long double keys, in the order nodeos writes them
+  const size_t secondary_key_sizes[] = {8, 16, 32, 8, 16};
+
+  struct export_stats {
+    uint64_t rows = 0;
+    uint64_t skipped = 0;
+  };
+
+  void export_contract_tables(reader r, uint64_t contract, const string& out) {
+    stat_table stat(out);
+    accounts_table accounts(out);
+    fcdbond_table fcdbond(out);
+    fcdborders_table fcdborders(out);
+    export_stats stats_by_table[4];
+
+    const uint64_t stat_name = name_value("stat");
+    const uint64_t accounts_name = name_value("accounts");
+    const uint64_t fcdbond_name = name_value("fcdbond");
+    const uint64_t fcdborders_name = name_value("fcdborders");
+
+    while(r.pos < r.end) {
+      // table_id_object
+      uint64_t code = r.get<uint64_t>();
+      uint64_t scope = r.get<uint64_t>();
+      uint64_t table = r.get<uint64_t>();
+      r.skip(8 + 4);                             // payer, count
+
+      int target = -1;
+      if(code == contract) {
+        if(table == stat_name)            target = 0;
+        else if(table == accounts_name)   target = 1;
+        else if(table == fcdbond_name)    target = 2;
+        else if(table == fcdborders_name) target = 3;
+      }
+
+      // key_value_object rows: primary_key, payer, value
+      uint32_t rows = r.varuint();
+      for(uint32_t i = 0; i < rows; i++) {
+        uint64_t key = r.get<uint64_t>();
+        r.skip(8);
+        string_view value = r.str();
+        if(target < 0)
+          continue;
+        reader row{value.data(), value.data() + value.size()};
+        switch(target) {
+          case 0: stat.add(scope, key, row); break;
+          case 1: accounts.add(scope, key, row); break;
+          case 2:
+            if(!fcdbond_table::valid(row)) {
+              stats_by_table[target].skipped++;
+              continue;
+            }
+            fcdbond.add(scope, key, row);
+            break;
+          case 3: fcdborders.add(scope, key, row); break;
+        }
+        stats_by_table[target].rows++;
+      }
+
+      // secondary index rows are not exported
+      for(size_t key_size : secondary_key_sizes) {
+        uint32_t count = r.varuint();
+        r.skip(size_t(count) * (8 + 8 + key_size));
+      }
+    }
+
+    const char* names[] = {"stat", "accounts", "fcdbond", "fcdborders"};
+    for(int i = 0; i < 4; i++)
+      cerr << names[i] << ": " << stats_by_table[i].rows << " rows"
+        << (stats_by_table[i].skipped ? ", " + to_string(stats_by_table[i].skipped) + " skipped" : string()) << "\n";
+  }
+
+  void export_snapshot(const char* data, size_t size, uint64_t contract, const string& out) {
+    reader r{data, data + size};
+    if(r.get<uint32_t>() != snapshot_magic)
+      throw runtime_error("not a portable snapshot");
+    uint32_t version = r.get<uint32_t>();
+    cerr << "snapshot version " << version << "\n";
+
+    for(;;) {
+      const char* section_start = r.pos;
+      uint64_t section_size = r.get<uint64_t>();
+      if(section_size == numeric_limits<uint64_t>::max())
+        break;                                   // end marker
+      const char* section_end = section_start + sizeof(uint64_t) + section_size;
+      if(section_end > r.end || section_end < r.pos)
+        throw runtime_error("section runs past the end of the snapshot");
+
+      r.skip(8);                                 // row count
+      string_view name = r.cstr();
+      if(name == "contract_tables") {
+        export_contract_tables(reader{r.pos, section_end}, contract, out);
+        return;
+      }
+      r.pos = section_end;
+    }
+    throw runtime_error("snapshot has no contract_tables section");
+  }
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if(argc != 4) {
+    cerr << "usage: snapexport CONTRACT SNAPSHOT OUTDIR\n"
+      "  writes stat, accounts, fcdbond and fcdborders of CONTRACT as columns into OUTDIR\n";
+    return 1;
+  }
+
+  try {
+    uint64_t contract = name_value(argv[1]);
+    string out = argv[3];
+    mkdir(out.c_str(), 0755);
+
+    int fd = open(argv[2], O_RDONLY);
+    if(fd < 0)
+      throw runtime_error(string("cannot open ") + argv[2]);
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+      throw runtime_error("mmap failed");
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    export_snapshot(static_cast<const char*>(data), size, contract, out);
+    munmap(data, size);
+  }
+  catch(const exception& e) {
+    cerr << "snapexport: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env node
+// Compile and instantiation time of contract wasm files under node's WebAssembly engine.
+//
+// usage: node tools/wasmbench/instantiate.js [--runs N] file.wasm...
+//
+// nodeos uses its own runtimes (eos-vm, eos-vm-jit, eos-vm-oc), so absolute numbers differ;
+// the point is comparing feature profiles of the same contract built the same way.
+// Host functions the contract imports are replaced by stubs, nothing is executed.
+
+'use strict';
+
+const fs = require('fs');
+
+function stubImports(module) {
+  const imports = {};
+  for (const imp of WebAssembly.Module.imports(module)) {
+    imports[imp.module] = imports[imp.module] || {};
+    if (imp.kind === 'function')
+      imports[imp.module][imp.name] = () => { throw new Error(`host function ${imp.name} called`); };
+    else if (imp.kind === 'memory')
+      imports[imp.module][imp.name] = new WebAssembly.Memory({ initial: 1 });
+    else if (imp.kind === 'table')
+      imports[imp.module][imp.name] = new WebAssembly.Table({ initial: 0, element: 'anyfunc' });
+    else if (imp.kind === 'global')
+      imports[imp.module][imp.name] = new WebAssembly.Global({ value: 'i32', mutable: false }, 0);
+  }
+  return imports;
+}
+
+function median(values) {
+  const sorted = [...values].sort((a, b) => a - b);
+  return sorted[Math.floor(sorted.length / 2)];
+}
+
+async function measure(file, runs) {
+  const bytes = fs.readFileSync(file);
+  const compile = [];
+  const instantiate = [];
+  let module;
+  for (let i = 0; i < runs; i++) {
+    let start = process.hrtime.bigint();
+    module = await WebAssembly.compile(bytes);
+    compile.push(Number(process.hrtime.bigint() - start) / 1e6);
+
+    const imports = stubImports(module);
+    start = process.hrtime.bigint();
+    await WebAssembly.instantiate(module, imports);
+    instantiate.push(Number(process.hrtime.bigint() - start) / 1e6);
+  }
+  return {
+    file,
+    bytes: bytes.length,
+    imports: WebAssembly.Module.imports(module).length,
+    exports: WebAssembly.Module.exports(module).length,
+    compile: median(compile),
+    instantiate: median(instantiate),
+  };
+}
+
+async function main() {
+  const args = process.argv.slice(2);
+  let runs = 20;
+  const files = [];
+  for (let i = 0; i < args.length; i++) {
+    if (args[i] === '--runs')
+      runs = parseInt(args[++i], 10);
+    else
+      files.push(args[i]);
+  }
+  if (files.length === 0 || !(runs > 0)) {
+    console.error('usage: instantiate.js [--runs N] file.wasm...');
+    process.exit(1);
+  }
+
+  console.log(`median of ${runs} runs`);
+  console.log('file'.padEnd(28) + 'bytes'.padStart(10) + 'imports'.padStart(9) + 'compile ms'.padStart(12) + 'instantiate ms'.padStart(16));
+  for (const file of files) {
+    const r = await measure(file, runs);
+    console.log(r.file.padEnd(28) + String(r.bytes).padStart(10) + String(r.imports).padStart(9)
+      + r.compile.toFixed(3).padStart(12) + r.instantiate.toFixed(3).padStart(16));
+  }
+}
+
+main().catch((e) => {
+  console.error(e.message);
+  process.exit(1);
+});